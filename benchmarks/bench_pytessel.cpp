@@ -0,0 +1,389 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   PyTessel is free software:                                           *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   PyTessel is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+/*
+ * Benchmark suite for the C++ core of PyTessel
+ *
+ * Constructs the isosurfaces of synthetic scalar fields (gyroid, icosahedral
+ * metaballs and a gaussian) for a range of grid sizes and reports the time
+ * spent per phase, the throughput and the peak resident set size as JSON,
+ * such that the results can be tracked over time.
+ *
+ * Build and run (from the root of the repository):
+ *
+ *     meson setup build && meson compile -C build pytessel_bench
+ *     ./build/pytessel_bench --sizes 64,128,256 --output results.json
+ *
+ * Options:
+ *
+ *     --sizes    comma separated grid sizes (default: 64,128,256,512)
+ *     --fields   comma separated fields (default: gyroid,metaballs,gaussian)
+ *     --methods  comma separated algorithms (default: cubes,tetrahedra);
+ *                also available: streaming, bricks, flying_edges
+ *     --repeat   number of repetitions per benchmark, the fastest
+ *                repetition is reported (default: 3)
+ *     --threads  number of threads (default: all available cores)
+ *     --output   file to write the JSON to (default: standard output)
+ *
+ * Note that a grid of 1024^3 points requires 4 GiB for the scalar field
+ * alone.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "scalar_field.h"
+#include "isosurface.h"
+#include "isosurface_mesh.h"
+#include "parallel.h"
+
+/**
+ * @brief      synthetic scalar field
+ */
+struct BenchmarkField {
+    std::string name;
+    float extent;       // the field is sampled on [-extent, extent]^3
+    float isovalue;
+    float (*func)(float, float, float);
+};
+
+/**
+ * @brief      extraction algorithm
+ */
+struct BenchmarkMethod {
+    std::string name;
+    ExtractionMethod method;
+};
+
+/**
+ * @brief      results of a single benchmark
+ */
+struct BenchmarkResult {
+    double t_scalar_field = 0.0;    // construct scalar field and brick table
+    double t_extract = 0.0;         // construct isosurface
+    double t_construct_mesh = 0.0;  // construct mesh (orientation, centering)
+    size_t nr_vertices = 0;
+    size_t nr_triangles = 0;
+};
+
+/**
+ * @brief      gyroid surface spanning two periods along every axis
+ */
+static float gyroid(float x, float y, float z) {
+    return std::sin(x) * std::cos(y) + std::sin(y) * std::cos(z) + std::sin(z) * std::cos(x);
+}
+
+/**
+ * @brief      metaballs positioned at the vertices of an icosahedron (see
+ *             examples/metaballs_icosahedron.py)
+ */
+static float metaballs(float x, float y, float z) {
+    static const float phi = (1.0f + std::sqrt(5.0f)) / 2.0f;
+    static const float vertices[12][3] = {
+        {0, 1, phi}, {0, -1, -phi}, {0, 1, -phi}, {0, -1, phi},
+        {1, phi, 0}, {-1, -phi, 0}, {1, -phi, 0}, {-1, phi, 0},
+        {phi, 0, 1}, {-phi, 0, -1}, {phi, 0, -1}, {-phi, 0, 1}
+    };
+
+    float value = 0.0f;
+    for(const auto& v : vertices) {
+        const float r2 = (x - v[0]) * (x - v[0]) + (y - v[1]) * (y - v[1]) + (z - v[2]) * (z - v[2]);
+        value += 1.0f / std::max(r2, 1e-12f);
+    }
+    return value;
+}
+
+/**
+ * @brief      gaussian centered in the unit cell
+ */
+static float gaussian(float x, float y, float z) {
+    return std::exp(-(x * x + y * y + z * z));
+}
+
+static const BenchmarkField benchmark_fields[] = {
+    {"gyroid", 6.2831853f, 0.01f, gyroid},
+    {"metaballs", 3.0f, 3.75f, metaballs},
+    {"gaussian", 3.0f, 0.1f, gaussian}
+};
+
+static const BenchmarkMethod benchmark_methods[] = {
+    {"cubes", ExtractionMethod::CUBES},
+    {"streaming", ExtractionMethod::STREAMING},
+    {"bricks", ExtractionMethod::BRICKS},
+    {"flying_edges", ExtractionMethod::FLYING_EDGES},
+    {"tetrahedra", ExtractionMethod::TETRAHEDRA}
+};
+
+/**
+ * @brief      get the peak resident set size of the process
+ *
+ * @return     peak resident set size in bytes
+ */
+static size_t get_peak_rss() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if(K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return usage.ru_maxrss;             // bytes
+#else
+    return usage.ru_maxrss * 1024;      // kilobytes
+#endif
+#endif
+}
+
+/**
+ * @brief      seconds elapsed since a point in time
+ */
+static double elapsed(const std::chrono::steady_clock::time_point& _start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+}
+
+/**
+ * @brief      split a comma separated list
+ */
+static std::vector<std::string> split(const std::string& _list) {
+    std::vector<std::string> items;
+    std::stringstream ss(_list);
+    std::string item;
+    while(std::getline(ss, item, ',')) {
+        if(!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+/**
+ * @brief      sample a synthetic field on a grid of n^3 points
+ *
+ * @param[in]  _field  the field
+ * @param[in]  _n      number of grid points along every axis
+ *
+ * @return     grid values (x fastest moving)
+ */
+static std::vector<float> sample_field(const BenchmarkField& _field, size_t _n) {
+    std::vector<float> grid(_n * _n * _n);
+    const float step = 2.0f * _field.extent / (float)(_n - 1);
+
+    parallel_for(0, _n, [&](size_t k) {
+        const float z = -_field.extent + k * step;
+        for(size_t j=0; j<_n; j++) {
+            const float y = -_field.extent + j * step;
+            for(size_t i=0; i<_n; i++) {
+                grid[(k * _n + j) * _n + i] = _field.func(-_field.extent + i * step, y, z);
+            }
+        }
+    }, Schedule::STATIC);
+
+    return grid;
+}
+
+/**
+ * @brief      construct the isosurface of a sampled field, keeping the
+ *             fastest time per phase over a number of repetitions
+ *
+ * @param[in]  _grid    grid values
+ * @param[in]  _n       number of grid points along every axis
+ * @param[in]  _field   the field
+ * @param[in]  _method  the algorithm
+ * @param[in]  _repeat  number of repetitions
+ *
+ * @return     the results
+ */
+static BenchmarkResult run_benchmark(const std::vector<float>& _grid, size_t _n, const BenchmarkField& _field,
+                                     const BenchmarkMethod& _method, size_t _repeat) {
+    const float length = 2.0f * _field.extent;
+    const std::vector<size_t> dimensions = {_n, _n, _n};
+    const std::vector<float> unitcell = {length, 0.0f, 0.0f, 0.0f, length, 0.0f, 0.0f, 0.0f, length};
+
+    BenchmarkResult result;
+    for(size_t r=0; r<_repeat; r++) {
+        auto start = std::chrono::steady_clock::now();
+        auto sf = std::make_shared<ScalarField>(_grid.data(), "f4", dimensions, unitcell);
+        sf->build_bricks();
+        const double t_scalar_field = elapsed(start);
+
+        start = std::chrono::steady_clock::now();
+        auto is = std::make_shared<IsoSurface>(sf);
+        is->set_compute_normals(true);
+        is->extract(_field.isovalue, _method.method);
+        const double t_extract = elapsed(start);
+
+        start = std::chrono::steady_clock::now();
+        IsoSurfaceMesh mesh(sf, is);
+        mesh.construct_mesh(true);
+        const double t_construct_mesh = elapsed(start);
+
+        if(r == 0 || t_scalar_field < result.t_scalar_field) {
+            result.t_scalar_field = t_scalar_field;
+        }
+        if(r == 0 || t_extract < result.t_extract) {
+            result.t_extract = t_extract;
+        }
+        if(r == 0 || t_construct_mesh < result.t_construct_mesh) {
+            result.t_construct_mesh = t_construct_mesh;
+        }
+        result.nr_vertices = mesh.get_nr_vertices();
+        result.nr_triangles = mesh.get_nr_indices() / 3;
+    }
+
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> sizes = {"64", "128", "256", "512"};
+    std::vector<std::string> fields = {"gyroid", "metaballs", "gaussian"};
+    std::vector<std::string> methods = {"cubes", "tetrahedra"};
+    size_t repeat = 3;
+    std::string output;
+
+    for(int i=1; i<argc; i++) {
+        const std::string arg = argv[i];
+        if(i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return EXIT_FAILURE;
+        }
+        const std::string value = argv[++i];
+        if(arg == "--sizes") {
+            sizes = split(value);
+        } else if(arg == "--fields") {
+            fields = split(value);
+        } else if(arg == "--methods") {
+            methods = split(value);
+        } else if(arg == "--repeat") {
+            repeat = std::max(1, std::atoi(value.c_str()));
+        } else if(arg == "--threads") {
+            set_num_threads(std::max(0, std::atoi(value.c_str())));
+        } else if(arg == "--output") {
+            output = value;
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"backend\": \"" << get_parallel_backend() << "\",\n";
+    json << "  \"threads\": " << get_num_threads() << ",\n";
+    json << "  \"repeat\": " << repeat << ",\n";
+    json << "  \"results\": [";
+
+    bool first = true;
+    for(const std::string& fieldname : fields) {
+        const BenchmarkField* field = nullptr;
+        for(const auto& f : benchmark_fields) {
+            if(f.name == fieldname) {
+                field = &f;
+            }
+        }
+        if(field == nullptr) {
+            std::cerr << "Unknown field: " << fieldname << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        for(const std::string& size : sizes) {
+            const size_t n = std::strtoul(size.c_str(), nullptr, 10);
+            if(n < 2) {
+                std::cerr << "Invalid grid size: " << size << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            const std::vector<float> grid = sample_field(*field, n);
+            const double t_sample = elapsed(start);
+
+            for(const std::string& methodname : methods) {
+                const BenchmarkMethod* method = nullptr;
+                for(const auto& m : benchmark_methods) {
+                    if(m.name == methodname) {
+                        method = &m;
+                    }
+                }
+                if(method == nullptr) {
+                    std::cerr << "Unknown method: " << methodname << std::endl;
+                    return EXIT_FAILURE;
+                }
+
+                std::cerr << field->name << " " << n << "^3 " << method->name << "..." << std::flush;
+                const BenchmarkResult result = run_benchmark(grid, n, *field, *method, repeat);
+                const double voxels = (double)(n - 1) * (double)(n - 1) * (double)(n - 1);
+                const double t_total = result.t_scalar_field + result.t_extract + result.t_construct_mesh;
+                std::cerr << " " << t_total << " s" << std::endl;
+
+                char buffer[1024];
+                std::snprintf(buffer, sizeof(buffer),
+                    "%s\n    {\n"
+                    "      \"field\": \"%s\",\n"
+                    "      \"size\": %zu,\n"
+                    "      \"method\": \"%s\",\n"
+                    "      \"isovalue\": %g,\n"
+                    "      \"voxels\": %.0f,\n"
+                    "      \"vertices\": %zu,\n"
+                    "      \"triangles\": %zu,\n"
+                    "      \"time\": {\"sample_field\": %.6f, \"scalar_field\": %.6f, "
+                    "\"extract\": %.6f, \"construct_mesh\": %.6f, \"total\": %.6f},\n"
+                    "      \"voxels_per_second\": %.6e,\n"
+                    "      \"triangles_per_second\": %.6e,\n"
+                    "      \"peak_rss_bytes\": %zu\n"
+                    "    }",
+                    first ? "" : ",", field->name.c_str(), n, method->name.c_str(), field->isovalue, voxels,
+                    result.nr_vertices, result.nr_triangles, t_sample, result.t_scalar_field, result.t_extract,
+                    result.t_construct_mesh, t_total, voxels / t_total, result.nr_triangles / t_total,
+                    get_peak_rss());
+                json << buffer;
+                first = false;
+            }
+        }
+    }
+    json << "\n  ]\n}\n";
+
+    if(output.empty()) {
+        std::cout << json.str();
+    } else {
+        std::ofstream out(output);
+        out << json.str();
+    }
+
+    return EXIT_SUCCESS;
+}
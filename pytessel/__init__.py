@@ -1,3 +1,3 @@
-from .pytessel_core import PyTessel
+from .pytessel_core import PyTessel, Tessellator
 
 from ._version import __version__
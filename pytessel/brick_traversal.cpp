@@ -0,0 +1,99 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   PyTessel is free software:                                           *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   PyTessel is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "brick_traversal.h"
+
+#include <algorithm>
+#include <utility>
+
+/**
+ * @brief      spread the lower 21 bits of an integer such that there are
+ *             two zero bits between every two consecutive bits
+ */
+static inline uint64_t spread_bits(uint64_t _v) {
+    _v &= 0x1FFFFF;
+    _v = (_v | (_v << 32)) & 0x1F00000000FFFFULL;
+    _v = (_v | (_v << 16)) & 0x1F0000FF0000FFULL;
+    _v = (_v | (_v << 8))  & 0x100F00F00F00F00FULL;
+    _v = (_v | (_v << 4))  & 0x10C30C30C30C30C3ULL;
+    _v = (_v | (_v << 2))  & 0x1249249249249249ULL;
+    return _v;
+}
+
+/**
+ * @brief      interleave the bits of three brick indices into their Morton
+ *             code; every index can use up to 21 bits
+ *
+ * @param[in]  _x    x index
+ * @param[in]  _y    y index
+ * @param[in]  _z    z index
+ *
+ * @return     Morton code
+ */
+uint64_t morton_encode(uint32_t _x, uint32_t _y, uint32_t _z) {
+    return spread_bits(_x) | (spread_bits(_y) << 1) | (spread_bits(_z) << 2);
+}
+
+/**
+ * @brief      divide a grid of cubes into bricks ordered along a Z-order
+ *             curve; bricks at the upper faces of the grid are truncated
+ *
+ * Because the number of bricks is in general not a power of two along every
+ * axis, the bricks are sorted by their Morton code rather than enumerated by
+ * decoding consecutive codes.
+ *
+ * @param[in]  _dimensions  number of cubes along x, y and z
+ * @param[in]  _bricksize   edge length of a brick
+ *
+ * @return     the bricks in Morton order
+ */
+std::vector<CubeBrick> get_morton_bricks(const size_t _dimensions[3], size_t _bricksize) {
+    size_t nbricks[3];
+    for(unsigned int d=0; d<3; d++) {
+        nbricks[d] = (_dimensions[d] + _bricksize - 1) / _bricksize;
+    }
+
+    std::vector<std::pair<uint64_t, CubeBrick>> codes;
+    codes.reserve(nbricks[0] * nbricks[1] * nbricks[2]);
+    for(size_t bz=0; bz<nbricks[2]; bz++) {
+        for(size_t by=0; by<nbricks[1]; by++) {
+            for(size_t bx=0; bx<nbricks[0]; bx++) {
+                const size_t b[3] = {bx, by, bz};
+                CubeBrick brick;
+                for(unsigned int d=0; d<3; d++) {
+                    brick.begin[d] = b[d] * _bricksize;
+                    brick.end[d] = std::min(brick.begin[d] + _bricksize, _dimensions[d]);
+                }
+                codes.emplace_back(morton_encode(bx, by, bz), brick);
+            }
+        }
+    }
+
+    std::sort(codes.begin(), codes.end(), [](const auto& a, const auto& b) {
+        return a.first < b.first;
+    });
+
+    std::vector<CubeBrick> bricks;
+    bricks.reserve(codes.size());
+    for(const auto& code : codes) {
+        bricks.push_back(code.second);
+    }
+    return bricks;
+}
@@ -0,0 +1,68 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   PyTessel is free software:                                           *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   PyTessel is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// edge length (in cubes) of the bricks used to traverse the grid
+#define TRAVERSAL_BRICK_SIZE 32
+
+/*
+ * Brick-tiled traversal of a grid of cubes. The grid is divided into bricks
+ * of (at most) TRAVERSAL_BRICK_SIZE^3 cubes, which are ordered along a
+ * Z-order (Morton) curve such that consecutive bricks are also close to each
+ * other in memory. A brick, including the single layer of grid points on its
+ * upper faces, fits in the L2 cache and is a natural unit of work when
+ * distributing the grid over threads.
+ */
+
+/**
+ * @brief      a block of cubes [begin, end) along x, y and z
+ */
+struct CubeBrick {
+    size_t begin[3];
+    size_t end[3];
+};
+
+/**
+ * @brief      interleave the bits of three brick indices into their Morton
+ *             code; every index can use up to 21 bits
+ *
+ * @param[in]  _x    x index
+ * @param[in]  _y    y index
+ * @param[in]  _z    z index
+ *
+ * @return     Morton code
+ */
+uint64_t morton_encode(uint32_t _x, uint32_t _y, uint32_t _z);
+
+/**
+ * @brief      divide a grid of cubes into bricks ordered along a Z-order
+ *             curve; bricks at the upper faces of the grid are truncated
+ *
+ * @param[in]  _dimensions  number of cubes along x, y and z
+ * @param[in]  _bricksize   edge length of a brick
+ *
+ * @return     the bricks in Morton order
+ */
+std::vector<CubeBrick> get_morton_bricks(const size_t _dimensions[3], size_t _bricksize = TRAVERSAL_BRICK_SIZE);
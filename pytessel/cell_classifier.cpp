@@ -0,0 +1,236 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   PyTessel is free software:                                           *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   PyTessel is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "cell_classifier.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PYTESSEL_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+typedef size_t (*classify_row_fn)(const float* const*, size_t, size_t, float, uint8_t*, uint64_t*);
+
+/**
+ * @brief      store the active flags of up to 64 cubes starting at cube _x
+ */
+static inline void set_active_bits(uint64_t* _active, size_t _x, uint64_t _bits) {
+    const size_t shift = _x % 64;
+    _active[_x / 64] |= _bits << shift;
+    if(shift != 0 && (_bits >> (64 - shift)) != 0) {
+        _active[_x / 64 + 1] |= _bits >> (64 - shift);
+    }
+}
+
+/**
+ * @brief      classify the cubes [_begin, _end) one-by-one; also used for
+ *             the remainder of the vectorized kernels
+ */
+static size_t classify_cube_row_scalar(const float* const _rows[4], size_t _begin, size_t _end,
+                                       float _isovalue, uint8_t* _cubeindices, uint64_t* _active) {
+    size_t nractive = 0;
+    for(size_t x=_begin; x<_end; x++) {
+        uint8_t cubidx = 0;
+        if (_rows[0][x]   < _isovalue) cubidx |= (1 << 0);
+        if (_rows[1][x]   < _isovalue) cubidx |= (1 << 1);
+        if (_rows[1][x+1] < _isovalue) cubidx |= (1 << 2);
+        if (_rows[0][x+1] < _isovalue) cubidx |= (1 << 3);
+        if (_rows[2][x]   < _isovalue) cubidx |= (1 << 4);
+        if (_rows[3][x]   < _isovalue) cubidx |= (1 << 5);
+        if (_rows[3][x+1] < _isovalue) cubidx |= (1 << 6);
+        if (_rows[2][x+1] < _isovalue) cubidx |= (1 << 7);
+        _cubeindices[x] = cubidx;
+        if(cubidx != 0 && cubidx != 255) {
+            set_active_bits(_active, x, 1);
+            nractive++;
+        }
+    }
+    return nractive;
+}
+
+#ifdef PYTESSEL_X86_DISPATCH
+
+__attribute__((target("sse2")))
+static size_t classify_cube_row_sse2(const float* const _rows[4], size_t _begin, size_t _end, float _isovalue,
+                                     uint8_t* _cubeindices, uint64_t* _active) {
+    const __m128 iso = _mm_set1_ps(_isovalue);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i full = _mm_set1_epi32(255);
+    size_t nractive = 0;
+    size_t x = _begin;
+
+    // the loads at x+1 read up to grid point x+4, i.e. the last grid point
+    // of the row when x+4 equals the number of cubes
+    for(; x + 4 <= _end; x += 4) {
+        __m128i c = zero;
+        c = _mm_or_si128(c, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(_mm_loadu_ps(_rows[0] + x), iso)), _mm_set1_epi32(1 << 0)));
+        c = _mm_or_si128(c, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(_mm_loadu_ps(_rows[1] + x), iso)), _mm_set1_epi32(1 << 1)));
+        c = _mm_or_si128(c, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(_mm_loadu_ps(_rows[1] + x + 1), iso)), _mm_set1_epi32(1 << 2)));
+        c = _mm_or_si128(c, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(_mm_loadu_ps(_rows[0] + x + 1), iso)), _mm_set1_epi32(1 << 3)));
+        c = _mm_or_si128(c, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(_mm_loadu_ps(_rows[2] + x), iso)), _mm_set1_epi32(1 << 4)));
+        c = _mm_or_si128(c, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(_mm_loadu_ps(_rows[3] + x), iso)), _mm_set1_epi32(1 << 5)));
+        c = _mm_or_si128(c, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(_mm_loadu_ps(_rows[3] + x + 1), iso)), _mm_set1_epi32(1 << 6)));
+        c = _mm_or_si128(c, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(_mm_loadu_ps(_rows[2] + x + 1), iso)), _mm_set1_epi32(1 << 7)));
+
+        // narrow the four 32 bit codes to bytes
+        const __m128i b = _mm_packus_epi16(_mm_packs_epi32(c, zero), zero);
+        const int32_t codes = _mm_cvtsi128_si32(b);
+        memcpy(_cubeindices + x, &codes, 4);
+
+        const __m128i inactive = _mm_or_si128(_mm_cmpeq_epi32(c, zero), _mm_cmpeq_epi32(c, full));
+        const uint64_t bits = (~_mm_movemask_ps(_mm_castsi128_ps(inactive))) & 0xF;
+        set_active_bits(_active, x, bits);
+        nractive += popcount64(bits);
+    }
+
+    return nractive + classify_cube_row_scalar(_rows, x, _end, _isovalue, _cubeindices, _active);
+}
+
+__attribute__((target("avx2")))
+static size_t classify_cube_row_avx2(const float* const _rows[4], size_t _begin, size_t _end, float _isovalue,
+                                     uint8_t* _cubeindices, uint64_t* _active) {
+    const __m256 iso = _mm256_set1_ps(_isovalue);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i full = _mm256_set1_epi32(255);
+    const __m256i shuffle = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                             0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m256i gather = _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0);
+    size_t nractive = 0;
+    size_t x = _begin;
+
+    for(; x + 8 <= _end; x += 8) {
+        __m256i c = zero;
+        c = _mm256_or_si256(c, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(_rows[0] + x), iso, _CMP_LT_OQ)), _mm256_set1_epi32(1 << 0)));
+        c = _mm256_or_si256(c, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(_rows[1] + x), iso, _CMP_LT_OQ)), _mm256_set1_epi32(1 << 1)));
+        c = _mm256_or_si256(c, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(_rows[1] + x + 1), iso, _CMP_LT_OQ)), _mm256_set1_epi32(1 << 2)));
+        c = _mm256_or_si256(c, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(_rows[0] + x + 1), iso, _CMP_LT_OQ)), _mm256_set1_epi32(1 << 3)));
+        c = _mm256_or_si256(c, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(_rows[2] + x), iso, _CMP_LT_OQ)), _mm256_set1_epi32(1 << 4)));
+        c = _mm256_or_si256(c, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(_rows[3] + x), iso, _CMP_LT_OQ)), _mm256_set1_epi32(1 << 5)));
+        c = _mm256_or_si256(c, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(_rows[3] + x + 1), iso, _CMP_LT_OQ)), _mm256_set1_epi32(1 << 6)));
+        c = _mm256_or_si256(c, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(_rows[2] + x + 1), iso, _CMP_LT_OQ)), _mm256_set1_epi32(1 << 7)));
+
+        // gather the low byte of every 32 bit code into the lowest 8 bytes
+        const __m256i b = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(c, shuffle), gather);
+        _mm_storel_epi64((__m128i*)(_cubeindices + x), _mm256_castsi256_si128(b));
+
+        const __m256i inactive = _mm256_or_si256(_mm256_cmpeq_epi32(c, zero), _mm256_cmpeq_epi32(c, full));
+        const uint64_t bits = (~_mm256_movemask_ps(_mm256_castsi256_ps(inactive))) & 0xFF;
+        set_active_bits(_active, x, bits);
+        nractive += popcount64(bits);
+    }
+
+    return nractive + classify_cube_row_scalar(_rows, x, _end, _isovalue, _cubeindices, _active);
+}
+
+__attribute__((target("avx512f")))
+static size_t classify_cube_row_avx512(const float* const _rows[4], size_t _begin, size_t _end, float _isovalue,
+                                       uint8_t* _cubeindices, uint64_t* _active) {
+    const __m512 iso = _mm512_set1_ps(_isovalue);
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i full = _mm512_set1_epi32(255);
+    size_t nractive = 0;
+    size_t x = _begin;
+
+    for(; x + 16 <= _end; x += 16) {
+        __m512i c = zero;
+        c = _mm512_or_si512(c, _mm512_maskz_set1_epi32(_mm512_cmp_ps_mask(_mm512_loadu_ps(_rows[0] + x), iso, _CMP_LT_OQ), 1 << 0));
+        c = _mm512_or_si512(c, _mm512_maskz_set1_epi32(_mm512_cmp_ps_mask(_mm512_loadu_ps(_rows[1] + x), iso, _CMP_LT_OQ), 1 << 1));
+        c = _mm512_or_si512(c, _mm512_maskz_set1_epi32(_mm512_cmp_ps_mask(_mm512_loadu_ps(_rows[1] + x + 1), iso, _CMP_LT_OQ), 1 << 2));
+        c = _mm512_or_si512(c, _mm512_maskz_set1_epi32(_mm512_cmp_ps_mask(_mm512_loadu_ps(_rows[0] + x + 1), iso, _CMP_LT_OQ), 1 << 3));
+        c = _mm512_or_si512(c, _mm512_maskz_set1_epi32(_mm512_cmp_ps_mask(_mm512_loadu_ps(_rows[2] + x), iso, _CMP_LT_OQ), 1 << 4));
+        c = _mm512_or_si512(c, _mm512_maskz_set1_epi32(_mm512_cmp_ps_mask(_mm512_loadu_ps(_rows[3] + x), iso, _CMP_LT_OQ), 1 << 5));
+        c = _mm512_or_si512(c, _mm512_maskz_set1_epi32(_mm512_cmp_ps_mask(_mm512_loadu_ps(_rows[3] + x + 1), iso, _CMP_LT_OQ), 1 << 6));
+        c = _mm512_or_si512(c, _mm512_maskz_set1_epi32(_mm512_cmp_ps_mask(_mm512_loadu_ps(_rows[2] + x + 1), iso, _CMP_LT_OQ), 1 << 7));
+
+        _mm_storeu_si128((__m128i*)(_cubeindices + x), _mm512_maskz_cvtepi32_epi8(0xFFFF, c));
+
+        const uint64_t bits = _mm512_cmpneq_epi32_mask(c, zero) & _mm512_cmpneq_epi32_mask(c, full);
+        set_active_bits(_active, x, bits);
+        nractive += popcount64(bits);
+    }
+
+    return nractive + classify_cube_row_scalar(_rows, x, _end, _isovalue, _cubeindices, _active);
+}
+
+#endif // PYTESSEL_X86_DISPATCH
+
+/**
+ * @brief      select the kernel for classification
+ *
+ * @param      _isa  name of the selected instruction set
+ *
+ * @return     the kernel
+ */
+static classify_row_fn select_classifier(const char** _isa) {
+    const char* env = getenv("PYTESSEL_SIMD");
+    const char* request = env ? env : "";
+
+#ifdef PYTESSEL_X86_DISPATCH
+    __builtin_cpu_init();
+    const bool any = request[0] == '\0';
+
+    if((any || strcmp(request, "avx512") == 0) && __builtin_cpu_supports("avx512f")) {
+        *_isa = "avx512";
+        return classify_cube_row_avx512;
+    }
+    if((any || strcmp(request, "avx2") == 0) && __builtin_cpu_supports("avx2")) {
+        *_isa = "avx2";
+        return classify_cube_row_avx2;
+    }
+    if((any || strcmp(request, "sse2") == 0) && __builtin_cpu_supports("sse2")) {
+        *_isa = "sse2";
+        return classify_cube_row_sse2;
+    }
+#endif
+
+    *_isa = "scalar";
+    return classify_cube_row_scalar;
+}
+
+static const char* classifier_isa = "scalar";
+static const classify_row_fn classifier = select_classifier(&classifier_isa);
+
+/**
+ * @brief      classify the cubes [_begin, _end) of a row
+ *
+ * @param[in]  _rows         pointers to the four rows of grid points
+ * @param[in]  _begin        first cube to classify
+ * @param[in]  _end          one past the last cube to classify
+ * @param[in]  _isovalue     The isovalue
+ * @param      _cubeindices  cube index of every cube (8 bit case code)
+ * @param      _active       bitmask of cubes intersected by the isosurface
+ *
+ * @return     number of active cubes in [_begin, _end)
+ */
+size_t classify_cube_row(const float* const _rows[4], size_t _begin, size_t _end, float _isovalue,
+                         uint8_t* _cubeindices, uint64_t* _active) {
+    return classifier(_rows, _begin, _end, _isovalue, _cubeindices, _active);
+}
+
+/**
+ * @brief      get the name of the instruction set used for classification
+ *
+ * @return     "scalar", "sse2", "avx2" or "avx512"
+ */
+const char* get_classifier_isa() {
+    return classifier_isa;
+}
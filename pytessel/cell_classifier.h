@@ -0,0 +1,92 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   PyTessel is free software:                                           *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   PyTessel is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Classification of cubes into their cube index (which of the eight corners
+ * lie below the isovalue) for a complete row of cubes at once.
+ *
+ * A row of cubes along x is spanned by four rows of grid points:
+ *
+ *   _rows[0] : (y,   z)        _rows[2] : (y,   z+1)
+ *   _rows[1] : (y+1, z)        _rows[3] : (y+1, z+1)
+ *
+ * Vectorized kernels (SSE2, AVX2 and AVX-512) are available on x86 and are
+ * selected at runtime based on the capabilities of the CPU, such that
+ * binaries built for generic x86-64 still use the widest instruction set
+ * available. The selection can be overruled by setting the environment
+ * variable PYTESSEL_SIMD to "scalar", "sse2", "avx2" or "avx512".
+ */
+
+/**
+ * @brief      classify the cubes [_begin, _end) of a row
+ *
+ * The cube indices and the active bits are stored at the position of the
+ * cube in the row. Active bits are only ever set; the caller is responsible
+ * for clearing the bitmask before classifying (a part of) a row.
+ *
+ * @param[in]  _rows         pointers to the four rows of grid points
+ * @param[in]  _begin        first cube to classify
+ * @param[in]  _end          one past the last cube to classify
+ * @param[in]  _isovalue     The isovalue
+ * @param      _cubeindices  cube index of every cube (8 bit case code)
+ * @param      _active       bitmask of cubes intersected by the isosurface
+ *
+ * @return     number of active cubes in [_begin, _end)
+ */
+size_t classify_cube_row(const float* const _rows[4], size_t _begin, size_t _end, float _isovalue,
+                         uint8_t* _cubeindices, uint64_t* _active);
+
+/**
+ * @brief      get the name of the instruction set used for classification
+ *
+ * @return     "scalar", "sse2", "avx2" or "avx512"
+ */
+const char* get_classifier_isa();
+
+/**
+ * @brief      count the number of set bits
+ */
+inline size_t popcount64(uint64_t _v) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(_v);
+#else
+    size_t c = 0;
+    for(; _v; _v &= _v - 1) c++;
+    return c;
+#endif
+}
+
+/**
+ * @brief      position of the lowest set bit (_v may not be zero)
+ */
+inline size_t ctz64(uint64_t _v) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(_v);
+#else
+    size_t c = 0;
+    for(; !(_v & 1); _v >>= 1) c++;
+    return c;
+#endif
+}
@@ -0,0 +1,62 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   PyTessel is free software:                                           *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   PyTessel is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "extraction_stats.h"
+
+/**
+ * @brief      remove all timings and counters
+ */
+void ExtractionStats::clear() {
+    this->timings.clear();
+    this->counters.clear();
+}
+
+/**
+ * @brief      add the time spent in a phase; phases executed several times
+ *             accumulate their time
+ *
+ * @param[in]  _phase    name of the phase
+ * @param[in]  _seconds  time spent in seconds
+ */
+void ExtractionStats::add_time(const std::string& _phase, double _seconds) {
+    for(auto& timing : this->timings) {
+        if(timing.first == _phase) {
+            timing.second += _seconds;
+            return;
+        }
+    }
+    this->timings.emplace_back(_phase, _seconds);
+}
+
+/**
+ * @brief      increment a counter, starting at zero
+ *
+ * @param[in]  _name   name of the counter
+ * @param[in]  _value  increment
+ */
+void ExtractionStats::add_counter(const std::string& _name, uint64_t _value) {
+    for(auto& counter : this->counters) {
+        if(counter.first == _name) {
+            counter.second += _value;
+            return;
+        }
+    }
+    this->counters.emplace_back(_name, _value);
+}
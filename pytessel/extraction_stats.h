@@ -0,0 +1,136 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   PyTessel is free software:                                           *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   PyTessel is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "trace.h"
+
+/**
+ * @brief      timings (per phase) and counters collected while constructing
+ *             an isosurface or an isosurface mesh
+ */
+class ExtractionStats {
+private:
+    std::vector<std::pair<std::string, double>> timings;    // seconds per phase, in order of execution
+    std::vector<std::pair<std::string, uint64_t>> counters; // counters, in order of registration
+
+public:
+    /**
+     * @brief      remove all timings and counters
+     */
+    void clear();
+
+    /**
+     * @brief      add the time spent in a phase; phases executed several
+     *             times accumulate their time
+     *
+     * @param[in]  _phase    name of the phase
+     * @param[in]  _seconds  time spent in seconds
+     */
+    void add_time(const std::string& _phase, double _seconds);
+
+    /**
+     * @brief      increment a counter, starting at zero
+     *
+     * @param[in]  _name   name of the counter
+     * @param[in]  _value  increment
+     */
+    void add_counter(const std::string& _name, uint64_t _value);
+
+    inline const std::vector<std::pair<std::string, double>>& get_timings() const {
+        return this->timings;
+    }
+
+    inline const std::vector<std::pair<std::string, uint64_t>>& get_counters() const {
+        return this->counters;
+    }
+};
+
+/**
+ * @brief      measures the time spent in consecutive phases of an algorithm;
+ *             the time of the current phase is added to the statistics when
+ *             moving on to the next phase or when leaving the scope, and is
+ *             recorded as an event when tracing is enabled
+ */
+class PhaseTimer {
+private:
+    ExtractionStats& stats;
+    const char* phase;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    /**
+     * @brief      start timing a phase
+     *
+     * @param      _stats  statistics to which the time is added
+     * @param[in]  _phase  name of the phase
+     */
+    PhaseTimer(ExtractionStats& _stats, const char* _phase) :
+        stats(_stats),
+        phase(_phase),
+        start(std::chrono::steady_clock::now()) {
+        set_trace_phase(_phase);
+    }
+
+    ~PhaseTimer() {
+        this->next(nullptr);
+    }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+    /**
+     * @brief      finish the current phase and start timing the next phase
+     *
+     * @param[in]  _phase  name of the next phase
+     */
+    inline void next(const char* _phase) {
+        const auto now = std::chrono::steady_clock::now();
+        if(this->phase != nullptr) {
+            this->stats.add_time(this->phase, std::chrono::duration<double>(now - this->start).count());
+            TraceBuffer* trace = get_trace_buffer();
+            if(trace != nullptr) {
+                trace->record(this->phase, "phase", this->start, now);
+            }
+        }
+        set_trace_phase(_phase);
+        this->phase = _phase;
+        this->start = now;
+    }
+};
+
+/**
+ * @brief      get the number of bytes reserved by a buffer
+ *
+ * @param[in]  _buffer  the buffer
+ *
+ * @return     number of bytes
+ */
+template<typename T>
+inline uint64_t get_buffer_bytes(const std::vector<T>& _buffer) {
+    return _buffer.capacity() * sizeof(T);
+}
@@ -0,0 +1,425 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   PyTessel is free software:                                           *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   PyTessel is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "field_readers.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include "mapped_file.h"
+#include "parallel.h"
+
+// minimum number of bytes of grid values per parallel chunk
+#define PARSE_CHUNK_SIZE (1 << 16)
+
+/**
+ * @brief      sequential reader of the lines of the header of a file
+ */
+class HeaderReader {
+private:
+    const char* pos;            // start of the next line
+    const char* end;            // end of the file
+    const std::string& filename;
+
+public:
+    HeaderReader(const MappedFile& _file, const std::string& _filename) :
+        pos(_file.get_data()),
+        end(_file.get_data() + _file.get_size()),
+        filename(_filename) {}
+
+    /**
+     * @brief      read the next line
+     *
+     * @return     the line (without the line break)
+     */
+    std::string next_line() {
+        if(this->pos >= this->end) {
+            throw std::runtime_error("Unexpected end of file: " + this->filename);
+        }
+        const char* eol = std::find(this->pos, this->end, '\n');
+        std::string line(this->pos, eol);
+        this->pos = eol < this->end ? eol + 1 : eol;
+        return line;
+    }
+
+    inline const char* get_position() const {
+        return this->pos;
+    }
+
+    inline const char* get_end() const {
+        return this->end;
+    }
+};
+
+/**
+ * @brief      whether a character separates two values; all control
+ *             characters are treated as whitespace
+ */
+static inline bool is_space(char c) {
+    return static_cast<unsigned char>(c) <= ' ';
+}
+
+/**
+ * @brief      parse a floating point number using strtof
+ *
+ * @param[in]  _begin  start of the number
+ * @param[in]  _end    end of the number
+ * @param[out] _value  the number
+ *
+ * @return     whether the characters form a valid number
+ */
+static bool parse_float_strtof(const char* _begin, const char* _end, float& _value) {
+    // strtof requires a terminated string
+    char buffer[64];
+    const size_t len = _end - _begin;
+    if(len == 0 || len >= sizeof(buffer)) {
+        return false;
+    }
+    std::memcpy(buffer, _begin, len);
+    buffer[len] = '\0';
+    char* stop = nullptr;
+    _value = std::strtof(buffer, &stop);
+    return stop == buffer + len;
+}
+
+/**
+ * @brief      parse a floating point number
+ *
+ * Uses std::from_chars when the standard library supports it for floating
+ * point numbers, and strtof otherwise or when the number is out of the
+ * range of a float (e.g. a density of 1E-50), such that it is flushed to
+ * zero (or infinity).
+ *
+ * @param[in]  _begin  start of the number
+ * @param[in]  _end    end of the number
+ * @param[out] _value  the number
+ *
+ * @return     whether the characters form a valid number
+ */
+static bool parse_float(const char* _begin, const char* _end, float& _value) {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    // from_chars does not accept a leading plus sign
+    const char* start = (_begin != _end && *_begin == '+') ? _begin + 1 : _begin;
+    const auto result = std::from_chars(start, _end, _value);
+    if(result.ec == std::errc() && result.ptr == _end) {
+        return true;
+    }
+    if(result.ec != std::errc::result_out_of_range) {
+        return false;
+    }
+#endif
+    return parse_float_strtof(_begin, _end, _value);
+}
+
+/**
+ * @brief      parse the first _count numbers of a whitespace-separated text
+ *             in parallel
+ *
+ * The text is split into chunks at whitespace. The numbers in every chunk
+ * are counted first, such that every chunk knows the index of its first
+ * number, after which all chunks are parsed independently.
+ *
+ * @param[in]  _begin     start of the text
+ * @param[in]  _end       end of the text
+ * @param[in]  _count     number of values to parse
+ * @param[in]  _store     callable storing the value with index t as
+ *                        _store(t, value)
+ * @param[in]  _filename  name of the file (for error messages)
+ *
+ * @return     false when the text holds fewer than _count numbers
+ */
+template<typename F>
+static bool parse_values(const char* _begin, const char* _end, size_t _count, F&& _store,
+                         const std::string& _filename) {
+    const size_t length = _end - _begin;
+    const size_t nchunks = std::max<size_t>(1, std::min<size_t>(length / PARSE_CHUNK_SIZE,
+                                                                get_num_threads() * 16));
+
+    // chunks start at whitespace such that no number is split
+    std::vector<const char*> bounds(nchunks + 1, _end);
+    bounds[0] = _begin;
+    for(size_t c=1; c<nchunks; c++) {
+        const char* p = std::max(bounds[c-1], _begin + c * (length / nchunks));
+        while(p < _end && !is_space(*p)) {
+            p++;
+        }
+        bounds[c] = p;
+    }
+
+    // count the numbers per chunk and convert the counts into offsets
+    std::vector<size_t> offsets(nchunks + 1, 0);
+    parallel_for(0, nchunks, [&](size_t c) {
+        // every chunk starts at whitespace (or at the start of the text);
+        // count the starts of the numbers, i.e. the non-whitespace
+        // characters preceded by whitespace, in a branchless loop
+        const unsigned char* text = reinterpret_cast<const unsigned char*>(bounds[c]);
+        const size_t n = bounds[c+1] - bounds[c];
+        size_t count = (n > 0 && text[0] > ' ');
+        for(size_t i=1; i<n; i++) {
+            count += (text[i] > ' ') & (text[i-1] <= ' ');
+        }
+        offsets[c+1] = count;
+    }, Schedule::DYNAMIC);
+    for(size_t c=0; c<nchunks; c++) {
+        offsets[c+1] += offsets[c];
+    }
+    if(offsets[nchunks] < _count) {
+        return false;
+    }
+
+    std::atomic<bool> valid(true);
+    parallel_for(0, nchunks, [&](size_t c) {
+        const char* p = bounds[c];
+        for(size_t t = offsets[c]; t < std::min(offsets[c+1], _count); t++) {
+            while(is_space(*p)) {
+                p++;
+            }
+            const char* q = p;
+            while(q < bounds[c+1] && !is_space(*q)) {
+                q++;
+            }
+            float value;
+            if(!parse_float(p, q, value)) {
+                valid = false;
+                return;
+            }
+            _store(t, value);
+            p = q;
+        }
+    }, Schedule::DYNAMIC);
+
+    if(!valid) {
+        throw std::runtime_error("Invalid grid value in file: " + _filename);
+    }
+
+    return true;
+}
+
+/**
+ * @brief      read a Gaussian CUBE file
+ *
+ * @param[in]  _filename  path to the file
+ *
+ * @return     the scalar field
+ */
+std::shared_ptr<ScalarField> read_cube(const std::string& _filename) {
+    const MappedFile file(_filename);
+    HeaderReader header(file, _filename);
+    const std::runtime_error invalid("Invalid CUBE file: " + _filename);
+
+    // two lines of comments
+    header.next_line();
+    header.next_line();
+
+    // number of atoms, origin and (optionally) the number of values per
+    // grid point
+    long natoms = 0;
+    size_t nvalues = 1;
+    {
+        std::istringstream line(header.next_line());
+        float origin[3];
+        if(!(line >> natoms >> origin[0] >> origin[1] >> origin[2])) {
+            throw invalid;
+        }
+        long n = 0;
+        if(line >> n && n > 1) {
+            nvalues = n;
+        }
+    }
+
+    // number of grid points and grid vector per axis
+    std::vector<size_t> dimensions(3);
+    std::vector<float> unitcell(9);
+    for(size_t i=0; i<3; i++) {
+        std::istringstream line(header.next_line());
+        long n = 0;
+        float v[3];
+        if(!(line >> n >> v[0] >> v[1] >> v[2]) || n == 0) {
+            throw invalid;
+        }
+        dimensions[i] = std::labs(n);
+        for(size_t j=0; j<3; j++) {
+            unitcell[i*3 + j] = v[j] * dimensions[i];
+        }
+    }
+
+    for(long i=0; i<std::labs(natoms); i++) {
+        header.next_line();
+    }
+
+    // a negative number of atoms indicates a list of orbitals, whose values
+    // are interleaved per grid point
+    if(natoms < 0) {
+        std::istringstream line(header.next_line());
+        size_t norbitals = 0;
+        if(!(line >> norbitals) || norbitals == 0) {
+            throw invalid;
+        }
+        nvalues = norbitals;
+        size_t nids = 0;
+        for(long id; line >> id; ) {
+            nids++;
+        }
+        while(nids < norbitals) {
+            std::istringstream more(header.next_line());
+            for(long id; more >> id; ) {
+                nids++;
+            }
+        }
+    }
+
+    // the values are stored with z as the fastest moving index
+    const size_t nx = dimensions[0];
+    const size_t ny = dimensions[1];
+    const size_t nz = dimensions[2];
+    std::vector<float> grid(nx * ny * nz);
+    const bool complete = parse_values(header.get_position(), header.get_end(), grid.size() * nvalues,
+                                       [&](size_t t, float value) {
+        if(t % nvalues == 0) {
+            const size_t p = t / nvalues;
+            grid[((p % nz) * ny + (p / nz) % ny) * nx + p / (ny * nz)] = value;
+        }
+    }, _filename);
+    if(!complete) {
+        throw std::runtime_error("Too few grid values in CUBE file: " + _filename);
+    }
+
+    return std::make_shared<ScalarField>(std::move(grid), dimensions, unitcell);
+}
+
+/**
+ * @brief      read a VASP CHGCAR, PARCHG or LOCPOT file
+ *
+ * @param[in]  _filename   path to the file
+ * @param[in]  _is_locpot  whether the file is a LOCPOT file
+ *
+ * @return     the scalar field
+ */
+std::shared_ptr<ScalarField> read_chgcar(const std::string& _filename, bool _is_locpot) {
+    const MappedFile file(_filename);
+    HeaderReader header(file, _filename);
+    const std::runtime_error invalid("Invalid CHGCAR/LOCPOT file: " + _filename);
+
+    // comment
+    header.next_line();
+
+    // scaling factor and lattice vectors; a negative scaling factor
+    // corresponds to the volume of the unitcell
+    double scale = 0.0;
+    if(!(std::istringstream(header.next_line()) >> scale)) {
+        throw invalid;
+    }
+    double lattice[3][3];
+    for(size_t i=0; i<3; i++) {
+        std::istringstream line(header.next_line());
+        if(!(line >> lattice[i][0] >> lattice[i][1] >> lattice[i][2])) {
+            throw invalid;
+        }
+    }
+    const double det = lattice[0][0] * (lattice[1][1] * lattice[2][2] - lattice[2][1] * lattice[1][2]) -
+                       lattice[0][1] * (lattice[1][0] * lattice[2][2] - lattice[1][2] * lattice[2][0]) +
+                       lattice[0][2] * (lattice[1][0] * lattice[2][1] - lattice[1][1] * lattice[2][0]);
+    if(scale < 0.0) {
+        scale = std::cbrt(-scale / std::fabs(det));
+    }
+    const double volume = std::fabs(det) * scale * scale * scale;
+
+    // element symbols (VASP 5 and later) and number of atoms per element
+    std::string line = header.next_line();
+    const size_t first = line.find_first_not_of(" \t\r");
+    if(first != std::string::npos && std::isalpha(static_cast<unsigned char>(line[first]))) {
+        line = header.next_line();
+    }
+    size_t natoms = 0;
+    {
+        std::istringstream counts(line);
+        for(size_t n; counts >> n; ) {
+            natoms += n;
+        }
+    }
+
+    // optional selective dynamics, the coordinate system and the positions
+    line = header.next_line();
+    const size_t pos = line.find_first_not_of(" \t\r");
+    if(pos != std::string::npos && (line[pos] == 'S' || line[pos] == 's')) {
+        header.next_line();
+    }
+    for(size_t i=0; i<natoms; i++) {
+        header.next_line();
+    }
+
+    // grid dimensions after an empty line
+    do {
+        line = header.next_line();
+    } while(line.find_first_not_of(" \t\r") == std::string::npos);
+    std::vector<size_t> dimensions(3);
+    {
+        std::istringstream grid_line(line);
+        if(!(grid_line >> dimensions[0] >> dimensions[1] >> dimensions[2])) {
+            throw invalid;
+        }
+    }
+
+    // the values are stored in lines of equal length; parsing is limited to
+    // the estimated extent of the first block of values, such that the
+    // augmentation occupancies and any further blocks (e.g. the
+    // magnetization) are skipped, unless the estimate turns out too small
+    const size_t count = dimensions[0] * dimensions[1] * dimensions[2];
+    const char* begin = header.get_position();
+    const char* end = header.get_end();
+    const char* eol = std::find(begin, end, '\n');
+    size_t perline = 0;
+    for(const char* p = begin; p < eol; p++) {
+        perline += !is_space(*p) && (p == begin || is_space(*(p-1)));
+    }
+    const char* blockend = end;
+    if(perline > 0 && eol < end) {
+        const size_t nlines = (count + perline - 1) / perline;
+        if(nlines * static_cast<size_t>(eol + 1 - begin) < static_cast<size_t>(end - begin)) {
+            blockend = std::find(begin + nlines * (eol + 1 - begin), end, '\n');
+        }
+    }
+
+    const float factor = _is_locpot ? 1.0f : static_cast<float>(1.0 / volume);
+    std::vector<float> grid(count);
+    auto store = [&](size_t t, float value) {
+        grid[t] = value * factor;
+    };
+    if(!parse_values(begin, blockend, count, store, _filename) &&
+       (blockend == end || !parse_values(begin, end, count, store, _filename))) {
+        throw std::runtime_error("Too few grid values in CHGCAR/LOCPOT file: " + _filename);
+    }
+
+    std::vector<float> unitcell(9);
+    for(size_t i=0; i<3; i++) {
+        for(size_t j=0; j<3; j++) {
+            unitcell[i*3 + j] = static_cast<float>(lattice[i][j] * scale);
+        }
+    }
+
+    return std::make_shared<ScalarField>(std::move(grid), dimensions, unitcell);
+}
@@ -0,0 +1,65 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   PyTessel is free software:                                           *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   PyTessel is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "scalar_field.h"
+
+/*
+ * Readers for volumetric data files. The headers are read sequentially,
+ * whereas the (large) blocks of grid values are parsed in parallel chunks.
+ * The files are memory-mapped rather than read into a buffer.
+ */
+
+/**
+ * @brief      read a Gaussian CUBE file
+ *
+ * The grid values are stored with z as the fastest moving index and are
+ * reordered such that x is the fastest moving index. The unitcell spans the
+ * grid vectors times the number of grid points along each axis and is
+ * expressed in the units of the file (Bohr, or Angstrom when the numbers of
+ * grid points are negative); the origin is not used. For files holding
+ * several orbitals, only the first orbital is read.
+ *
+ * @param[in]  _filename  path to the file
+ *
+ * @return     the scalar field
+ */
+std::shared_ptr<ScalarField> read_cube(const std::string& _filename);
+
+/**
+ * @brief      read a VASP CHGCAR, PARCHG or LOCPOT file
+ *
+ * The grid values are stored with x as the fastest moving index. The
+ * unitcell is the (scaled) lattice in Angstrom. Only the first block of grid
+ * values is read, i.e. the total density of spin-polarized calculations.
+ * The values of CHGCAR files, which hold the density times the volume of
+ * the unitcell, are divided by the volume.
+ *
+ * @param[in]  _filename   path to the file
+ * @param[in]  _is_locpot  whether the file is a LOCPOT file, such that the
+ *                         values are used as is
+ *
+ * @return     the scalar field
+ */
+std::shared_ptr<ScalarField> read_chgcar(const std::string& _filename, bool _is_locpot = false);
@@ -19,104 +19,7 @@
  **************************************************************************/
 
 #include "isosurface.h"
-
-/**************
- *    CUBE    *
- **************/
-
-/*
- *          z
- *          |
- *          4------5
- *         /|     /|
- *        7-|----6 |
- *        | 0----|-1--- y (j)
- *        |/     |/
- *        3 ---- 2
- *       /
- *      x (i)
- *
- */
-
-Cube::Cube(size_t _i, size_t _j, size_t _k, const ScalarField &_vp) {
-
-    this->i = _i;
-    this->j = _j;
-    this->k = _k;
-    this->cubidx = 0;
-
-    values[0] = _vp.get_value(_i, _j, _k);
-    values[1] = _vp.get_value(_i, _j+1, _k);
-    values[2] = _vp.get_value(_i+1, _j+1, _k);
-    values[3] = _vp.get_value(_i+1, _j, _k);
-
-    values[4] = _vp.get_value(_i, _j, _k+1);
-    values[5] = _vp.get_value(_i, _j+1, _k+1);
-    values[6] = _vp.get_value(_i+1, _j+1, _k+1);
-    values[7] = _vp.get_value(_i+1, _j, _k+1);
-}
-
-void Cube::set_cube_index(float _isovalue) {
-    if (this->values[0] < _isovalue) this->cubidx |= (1 << 0);
-    if (this->values[1] < _isovalue) this->cubidx |= (1 << 1);
-    if (this->values[2] < _isovalue) this->cubidx |= (1 << 2);
-    if (this->values[3] < _isovalue) this->cubidx |= (1 << 3);
-    if (this->values[4] < _isovalue) this->cubidx |= (1 << 4);
-    if (this->values[5] < _isovalue) this->cubidx |= (1 << 5);
-    if (this->values[6] < _isovalue) this->cubidx |= (1 << 6);
-    if (this->values[7] < _isovalue) this->cubidx |= (1 << 7);
-}
-
-size_t Cube::get_cube_index() const {
-    return this->cubidx;
-}
-
-float Cube::get_value_from_vertex(size_t _p) const {
-    return this->values[_p];
-}
-
-Vec3 Cube::get_position_from_vertex(size_t _p) const {
-    Vec3 c;
-    if(_p == 0) {
-        c.x = (float)this->i;
-        c.y = (float)this->j;
-        c.z = (float)this->k;
-    } else if(_p == 1) {
-        c.x = (float)this->i;
-        c.y = (float)this->j+1;
-        c.z = (float)this->k;
-    } else if(_p == 2) {
-        c.x = (float)this->i+1;
-        c.y = (float)this->j+1;
-        c.z = (float)this->k;
-    } else if(_p == 3) {
-        c.x = (float)this->i+1;
-        c.y = (float)this->j;
-        c.z = (float)this->k;
-    } else if(_p == 4) {
-        c.x = (float)this->i;
-        c.y = (float)this->j;
-        c.z = (float)this->k+1;
-    } else if(_p == 5) {
-        c.x = (float)this->i;
-        c.y = (float)this->j+1;
-        c.z = (float)this->k+1;
-    } else if(_p == 6) {
-        c.x = (float)this->i+1;
-        c.y = (float)this->j+1;
-        c.z = (float)this->k+1;
-    } else if(_p == 7) {
-        c.x = (float)this->i+1;
-        c.y = (float)this->j;
-        c.z = (float)this->k+1;
-    } else {
-        c.x = 0;
-        c.y = 0;
-        c.z = 0;
-    }
-
-    return c;
-}
+#include "parallel.h"
 
 /*********************
  *    TETRAHEDRON    *
@@ -229,63 +132,105 @@ const Vec3& Tetrahedron::get_position_from_vertex(size_t _p) const {
 }
 
 /**************
- *  TRIANGLE  *
+ * ISOSURFACE *
  **************/
 
-Triangle::Triangle(const Vec3 &_p1, const Vec3 &_p2, const Vec3 &_p3) {
-    this->p1 = _p1;
-    this->p2 = _p2;
-    this->p3 = _p3;
-}
+/*
+ * Grid edge directions (encoded as (dx+1) + 3*(dy+1) + 9*(dz+1)) which are
+ * traversed by the algorithms. The directions are sorted in ascending order
+ * such that the vertex table is sorted by edge id.
+ */
 
-void Triangle::transform_to_real(const ScalarField &_vp) {
-    p1 = _vp.grid_to_realspace(p1.x, p1.y, p1.z);
-    p2 = _vp.grid_to_realspace(p2.x, p2.y, p2.z);
-    p3 = _vp.grid_to_realspace(p3.x, p3.y, p3.z);
-}
+// marching cubes: +x, +y and +z
+static const std::vector<uint8_t> cube_edge_directions = {14, 16, 22};
 
-float Triangle::get_x(size_t i) const {
-    switch(i) {
-        case 0:
-            return p1.x;
-        case 1:
-            return p2.x;
-        case 2:
-            return p3.x;
-        default:
-            return p1.x;
-    }
-}
+/*
+ *          z
+ *          |
+ *          4------5
+ *         /|     /|
+ *        7-|----6 |
+ *        | 0----|-1--- y (j)
+ *        |/     |/
+ *        3 ---- 2
+ *       /
+ *      x (i)
+ *
+ * Location of the twelve cube edges with respect to vertex 0 of the cube:
+ * plane (offset in z; 0: bottom, 1: top), offset in x, offset in y and axis
+ * of the edge (0: x, 1: y, 2: z)
+ */
+static constexpr uint8_t cube_edge_plane_table[12][4] = {
+    {0, 0, 0, 1}, {0, 0, 1, 0}, {0, 1, 0, 1}, {0, 0, 0, 0},
+    {1, 0, 0, 1}, {1, 0, 1, 0}, {1, 1, 0, 1}, {1, 0, 0, 0},
+    {0, 0, 0, 2}, {0, 0, 1, 2}, {0, 1, 1, 2}, {0, 1, 0, 2}
+};
 
-float Triangle::get_y(size_t i) const {
-    switch(i) {
-        case 0:
-            return p1.y;
-        case 1:
-            return p2.y;
-        case 2:
-            return p3.y;
-        default:
-            return p1.y;
+/**
+ * @brief      get the offset of the first grid point of every cube edge with
+ *             respect to vertex 0 of the cube and the encoded direction of
+ *             the edge
+ *
+ * @param[in]  _nx          number of grid points along x
+ * @param[in]  _planesize   number of grid points per z-plane
+ * @param      _offsets     offset per edge
+ * @param      _directions  direction per edge
+ */
+static void get_cube_edge_offsets(uint64_t _nx, uint64_t _planesize, uint64_t _offsets[12],
+                                  uint8_t _directions[12]) {
+    for(size_t e=0; e<12; e++) {
+        const uint8_t* loc = cube_edge_plane_table[e];
+        _offsets[e] = loc[0] * _planesize + loc[2] * _nx + loc[1];
+        _directions[e] = cube_edge_directions[loc[3]];
     }
 }
 
-float Triangle::get_z(size_t i) const {
-    switch(i) {
-        case 0:
-            return p1.z;
-        case 1:
-            return p2.z;
-        case 2:
-            return p3.z;
-        default:
-            return p1.z;
-    }
+/*
+ * Location of the twelve cube edges for the flying edges algorithm: grid row
+ * among the four rows spanning a row of cubes (bit 0: +y, bit 1: +z), axis of
+ * the edge (0: x, 1: y, 2: z) and offset in x
+ */
+static constexpr uint8_t cube_edge_row_table[12][3] = {
+    {0, 1, 0}, {1, 0, 0}, {0, 1, 1}, {0, 0, 0},
+    {2, 1, 0}, {3, 0, 0}, {2, 1, 1}, {2, 0, 0},
+    {0, 2, 0}, {1, 2, 0}, {1, 2, 1}, {0, 2, 1}
+};
+
+/*
+ * Bookkeeping per grid row for the flying edges algorithm: first and last
+ * grid point of the intersected x-edges, trimmed range of points to visit,
+ * position of the first x-, y- and z-edge vertex and the first triangle
+ */
+enum {
+    FE_XMIN,
+    FE_XMAX,
+    FE_LEFT,
+    FE_RIGHT,
+    FE_XEDGES,
+    FE_YEDGES,
+    FE_ZEDGES,
+    FE_TRIANGLES,
+    FE_ROW_SIZE
+};
+
+/*
+ * Cube index of the cube at position x of a row of cubes, built from the
+ * classification of the grid points of the four rows spanning the row of
+ * cubes (see cube_edge_row_table for the order of the rows)
+ */
+static inline uint8_t flying_edges_cube_index(const uint8_t* const _cases[4], size_t _x) {
+    return  _cases[0][_x]          | (_cases[1][_x] << 1)   | (_cases[1][_x+1] << 2) |
+           (_cases[0][_x+1] << 3)  | (_cases[2][_x] << 4)   | (_cases[3][_x] << 5)   |
+           (_cases[3][_x+1] << 6)  | (_cases[2][_x+1] << 7);
 }
 
-/**************
- * ISOSURFACE *
- **************/
+// marching tetrahedra: +x, +y, (1,1,0), (0,-1,1), +z, (1,0,1) and (1,1,1)
+static const std::vector<uint8_t> tetrahedron_edge_directions = {14, 16, 17, 19, 22, 23, 26};
+
+// number of triangles generated for each tetrahedron index
+static const uint8_t tetrahedron_triangle_count_table[16] = {
+    0, 1, 1, 2, 1, 2, 2, 1, 1, 2, 2, 1, 2, 1, 1, 0
+};
 
 /**
  * @brief      default constructor
@@ -293,269 +238,1843 @@ float Triangle::get_z(size_t i) const {
  * @param      _sf   pointer to ScalarField object
  */
 IsoSurface::IsoSurface(const std::shared_ptr<ScalarField>& _vp) :
-    vp_ptr(_vp) {
+    vp_ptr(_vp),
+    compute_normals(false),
+    keep_buffers(false) {
     this->isovalue = 0;
     this->vp_ptr->copy_grid_dimensions(this->grid_dimensions);
 }
 
+/**
+ * @brief      generate isosurface using the specified algorithm
+ *
+ * @param[in]  _isovalue  The isovalue
+ * @param[in]  _method    The algorithm
+ */
+void IsoSurface::extract(float _isovalue, ExtractionMethod _method) {
+    switch(_method) {
+        case ExtractionMethod::STREAMING:
+            this->marching_cubes_streaming(_isovalue);
+        break;
+        case ExtractionMethod::BRICKS:
+            this->marching_cubes_bricked(_isovalue);
+        break;
+        case ExtractionMethod::FLYING_EDGES:
+            this->flying_edges(_isovalue);
+        break;
+        case ExtractionMethod::TETRAHEDRA:
+            this->marching_tetrahedra(_isovalue);
+        break;
+        default:
+            this->marching_cubes(_isovalue);
+        break;
+    }
+}
+
 /**
  * @brief      generate isosurface using marching cubes algorithm
  *
  * @param[in]  _isovalue  The isovalue
  */
 void IsoSurface::marching_cubes(float _isovalue) {
+    this->stats.clear();
+    PhaseTimer timer(this->stats, "brick_table");
     this->isovalue = _isovalue;
+    this->cube_table.clear();
+    this->indices.clear();
+    this->vp_ptr->build_bricks();
+    timer.next("vertices");
+    this->construct_vertices(_isovalue, cube_edge_directions);
+    timer.next("classify");
     this->sample_grid_with_cubes(_isovalue);
-    this->construct_triangles_from_cubes(_isovalue);
+    timer.next("triangles");
+    const uint64_t nrlookups = this->construct_triangles_from_cubes();
+    timer.next(nullptr);
+    this->record_counters(this->cube_table.size(), nrlookups);
+}
+
+/**
+ * @brief      generate isosurface using marching cubes algorithm while
+ *             traversing the grid brick-by-brick
+ *
+ * Rather than performing separate passes over the complete grid for the
+ * vertices, the cubes and the triangles, every brick is processed by a
+ * single task which classifies its cubes, interpolates its vertices and
+ * normals and builds its triangles while the grid values of the brick
+ * reside in cache. The triangles are the same as those of marching_cubes,
+ * but both the vertices and the triangles are ordered by brick (in Morton
+ * order).
+ *
+ * @param[in]  _isovalue  The isovalue
+ */
+void IsoSurface::marching_cubes_bricked(float _isovalue) {
+    this->stats.clear();
+    PhaseTimer timer(this->stats, "brick_table");
+    this->isovalue = _isovalue;
+    this->cube_table.clear();
+    this->indices.clear();
+    this->vp_ptr->build_bricks();
+    timer.next("extract_bricks");
+
+    const size_t cube_dimensions[3] = {this->grid_dimensions[0] - 1,
+                                       this->grid_dimensions[1] - 1,
+                                       this->grid_dimensions[2] - 1};
+    const std::vector<CubeBrick> bricks = get_morton_bricks(cube_dimensions);
+    this->brick_geometries.resize(bricks.size());
+
+    // the bricks are handed out one at a time in Morton order, such that
+    // idle threads keep picking up the next available brick
+    parallel_for(0, bricks.size(), [&](size_t b) {
+        this->extract_brick(bricks[b], _isovalue, this->brick_geometries[b]);
+    }, Schedule::DYNAMIC);
 
-    #pragma omp parallel for
-    for(size_t i=0; i < this->triangles.size(); i++) {
-        triangles[i].transform_to_real(*this->vp_ptr);
+    timer.next("stitch");
+    this->stitch_bricks(bricks, this->brick_geometries);
+}
+
+/**
+ * @brief      generate isosurface using marching cubes algorithm while
+ *             streaming over the z-planes of the grid
+ *
+ * Instead of collecting all active cubes, only the vertex indices of the
+ * edges of two consecutive planes of grid points and the cube indices of a
+ * single slab are kept, such that the working memory scales with nx*ny.
+ * Vertices and indices are emitted directly in the same order as produced
+ * by marching_cubes, hence both routines yield identical meshes.
+ *
+ * @param[in]  _isovalue  The isovalue
+ */
+void IsoSurface::marching_cubes_streaming(float _isovalue) {
+    this->begin_streaming(_isovalue);
+    for(size_t z=0; z < this->grid_dimensions[2] - 1; z++) {
+        this->stream_slab(z);
     }
+    this->end_streaming();
 }
 
 /**
- * @brief      generate isosurface using marching tetrahedra algorithm
+ * @brief      generate isosurface using marching cubes algorithm while
+ *             streaming over tiles of z-planes of the grid
+ *
+ * The slabs of cubes are processed in the same order as by
+ * marching_cubes_streaming, hence both routines yield identical meshes, but
+ * grouped in tiles of consecutive slabs. For memory-mapped grids, the planes
+ * of the next tile are read ahead while a tile is processed and the planes
+ * behind the sweep are released afterwards. The slabs of a tile [z0, z1)
+ * read the grid planes [z0, z1 + 3), including the neighbouring planes for
+ * the central-difference gradients, such that consecutive tiles overlap by
+ * three planes.
+ *
+ * @param[in]  _isovalue       The isovalue
+ * @param[in]  _memory_budget  maximum number of bytes of the grid resident
+ *                             at once
+ */
+void IsoSurface::marching_cubes_tiled(float _isovalue, size_t _memory_budget) {
+    const size_t nz = this->grid_dimensions[2];
+    const size_t maxplanes = std::max<size_t>(8, _memory_budget / this->vp_ptr->get_plane_bytes());
+    const size_t tile = std::max<size_t>(1, (maxplanes - 6) / 2);
+
+    this->begin_streaming(_isovalue, maxplanes);
+    this->vp_ptr->prefetch_planes(0, tile + 3);
+    for(size_t z0=0; z0 < nz - 1; z0 += tile) {
+        const size_t z1 = std::min(z0 + tile, nz - 1);
+        this->vp_ptr->prefetch_planes(z1 + 3, z1 + tile + 3);
+        for(size_t z=z0; z<z1; z++) {
+            this->stream_slab(z);
+        }
+        this->vp_ptr->release_planes(z0, z1);
+    }
+    this->vp_ptr->release_planes(0, nz);
+    this->end_streaming();
+}
+
+/**
+ * @brief      generate isosurface using the flying edges algorithm
+ *
+ * Flying edges (Schroeder et al., 2015) processes the grid row by row along
+ * x in four passes: (1) classify the grid points and locate the intersected
+ * x-edges of every row, (2) count the intersected y- and z-edges and the
+ * triangles within the trimmed part of every row, (3) convert the counts to
+ * offsets and (4) generate the vertices and the triangles. Every grid value
+ * is read only once and every pass is parallel over the rows. The triangles
+ * are identical to those of marching_cubes, but the vertices are ordered
+ * per row and per axis.
  *
  * @param[in]  _isovalue  The isovalue
  */
-void IsoSurface::marching_tetrahedra(float _isovalue) {
+void IsoSurface::flying_edges(float _isovalue) {
+    const size_t nrows = this->grid_dimensions[1] * this->grid_dimensions[2];
+
+    this->stats.clear();
+    PhaseTimer timer(this->stats, "classify");
     this->isovalue = _isovalue;
-    this->sample_grid_with_tetrahedra(_isovalue);
-    this->construct_triangles_from_tetrahedra(_isovalue);
-    for(std::vector<Triangle>::iterator it = triangles.begin();
-        it != triangles.end(); ++it) {
-        it->transform_to_real(*this->vp_ptr);
+    this->cube_table.clear();
+    this->edge_ids.clear();
+    this->row_offsets.clear();
+    this->vertices.clear();
+    this->normals.clear();
+    this->indices.clear();
+
+    // pass 1 and 2
+    this->flying_edges_classify(_isovalue);
+    timer.next("count");
+    this->flying_edges_count();
+
+    // pass 3: convert the counts into offsets
+    timer.next("offsets");
+    size_t nrvertices = 0;
+    size_t nrtriangles = 0;
+    for(size_t r=0; r<nrows; r++) {
+        size_t* row = &this->edge_rows[r * FE_ROW_SIZE];
+        for(size_t a=FE_XEDGES; a<=FE_ZEDGES; a++) {
+            const size_t count = row[a];
+            row[a] = nrvertices;
+            nrvertices += count;
+        }
+        const size_t count = row[FE_TRIANGLES];
+        row[FE_TRIANGLES] = nrtriangles;
+        nrtriangles += count;
+    }
+    this->vertices.resize(nrvertices);
+    this->normals.resize(this->compute_normals ? nrvertices : 0);
+    this->indices.resize(nrtriangles * 3);
+
+    // pass 4
+    timer.next("vertices");
+    this->flying_edges_vertices(_isovalue);
+    timer.next("triangles");
+    const uint64_t nractive = this->flying_edges_triangles();
+    timer.next(nullptr);
+
+    this->record_counters(nractive, 0);
+    this->release_buffer(this->point_cases);
+    this->release_buffer(this->edge_rows);
+}
+
+/**
+ * @brief      generate the isosurfaces of several isovalues using the
+ *             marching cubes algorithm in a single sweep over the grid
+ *
+ * The streaming algorithm is run for all isovalues simultaneously: the
+ * rows of grid points of every slab are read (and converted to single
+ * precision) once, after which the cubes are classified for all isovalues
+ * from that single read. Only then are the vertices and triangles of the
+ * slab emitted for each isovalue in turn. Every isosurface is identical to
+ * the one produced by marching_cubes for the same isovalue.
+ *
+ * @param[in]  _sf         pointer to ScalarField object
+ * @param[in]  _isovalues  The isovalues
+ * @param[in]  _compute_normals  whether to calculate the normals
+ *
+ * @return     one isosurface per isovalue
+ */
+std::vector<std::shared_ptr<IsoSurface>> IsoSurface::marching_cubes_multi(const std::shared_ptr<ScalarField>& _sf,
+                                                                          const std::vector<float>& _isovalues,
+                                                                          bool _compute_normals) {
+    std::vector<std::shared_ptr<IsoSurface>> surfaces;
+    for(float isovalue : _isovalues) {
+        surfaces.push_back(std::make_shared<IsoSurface>(_sf));
+        surfaces.back()->set_compute_normals(_compute_normals);
+        surfaces.back()->begin_streaming(isovalue);
+    }
+
+    if(!surfaces.empty()) {
+        for(size_t z=0; z < surfaces.front()->grid_dimensions[2] - 1; z++) {
+            stream_classify_levels(surfaces, z);
+            for(auto& surface : surfaces) {
+                surface->stream_slab(z, false);
+            }
+        }
+    }
+
+    for(auto& surface : surfaces) {
+        surface->end_streaming();
     }
+
+    return surfaces;
 }
 
 /**
- * @brief      Gets the triangles pointer.
+ * @brief      generate isosurface using marching tetrahedra algorithm
  *
- * @return     The triangles pointer.
+ * @param[in]  _isovalue  The isovalue
  */
-const std::vector<Triangle>* IsoSurface::get_triangles_ptr() const {
-    return &this->triangles;
+void IsoSurface::marching_tetrahedra(float _isovalue) {
+    this->stats.clear();
+    PhaseTimer timer(this->stats, "vertices");
+    this->isovalue = _isovalue;
+    this->indices.clear();
+    this->construct_vertices(_isovalue, tetrahedron_edge_directions);
+    timer.next("classify");
+    const uint64_t nractive = this->sample_grid_with_tetrahedra(_isovalue);
+    timer.next("triangles");
+    const uint64_t nrlookups = this->construct_triangles_from_tetrahedra(_isovalue);
+    timer.next(nullptr);
+    this->record_counters(nractive, nrlookups);
 }
 
+/**
+ * @brief      collect all cubes that are intersected by the isosurface
+ *
+ * The grid is processed per slab (the cubes between two consecutive
+ * z-planes). A first pass counts the number of active cubes and the number
+ * of triangles they will yield for every slab, after which an exclusive scan
+ * over the slabs provides the position of every slab in the (preallocated)
+ * output buffers. A second pass fills the cube table. Because every slab
+ * writes to its own segment, no locking is required and the order of the
+ * cubes is independent of the number of threads.
+ *
+ * @param[in]  _isovalue  The isovalue
+ */
 void IsoSurface::sample_grid_with_cubes(float _isovalue) {
-    std::mutex push_back_mutex;
+    const size_t nslabs = this->grid_dimensions[2] - 1;
+    const size_t nrcubes = this->grid_dimensions[0] - 1;
+    const size_t nrwords = (nrcubes + 63) / 64;
+    this->slab_cube_offsets.assign(nslabs + 1, 0);
+    this->slab_triangle_offsets.assign(nslabs + 1, 0);
 
-    #pragma omp parallel for schedule(dynamic)
-    for(size_t i = 0; i < this->grid_dimensions[2] - 1; i++) {
+    // count active cubes and triangles per slab
+    parallel_for(0, nslabs, [&](size_t i) {
+        std::vector<uint8_t> cubeindices(nrcubes);
+        std::vector<uint64_t> active(nrwords);
+        std::vector<std::pair<size_t, size_t>> ranges;
+        std::vector<float> rowbuffer;
+        size_t nrcubes_active = 0;
+        size_t nrtriangles = 0;
         for(size_t j = 0; j < this->grid_dimensions[1] - 1; j++) {
-            for(size_t k = 0; k < this->grid_dimensions[0] - 1; k++) {
-                Cube cub(k, j, i, *this->vp_ptr);
-                cub.set_cube_index(_isovalue);
-                if(!(cub.get_cube_index() == (size_t)0 ||
-                    cub.get_cube_index() == (size_t)255)) {
-                    push_back_mutex.lock();
-                    this->cube_table.push_back(cub);
-                    push_back_mutex.unlock();
+            if(this->classify_cubes(j, i, _isovalue, 0, nrcubes, cubeindices.data(), active.data(), ranges, rowbuffer) == 0) {
+                continue;
+            }
+            for(size_t w = 0; w < nrwords; w++) {
+                for(uint64_t bits = active[w]; bits; bits &= bits - 1) {
+                    nrcubes_active++;
+                    nrtriangles += triangle_count_table[cubeindices[w * 64 + ctz64(bits)]];
+                }
+            }
+        }
+        this->slab_cube_offsets[i+1] = nrcubes_active;
+        this->slab_triangle_offsets[i+1] = nrtriangles;
+    }, Schedule::DYNAMIC);
+
+    // exclusive scan over the slabs
+    for(size_t i = 1; i <= nslabs; i++) {
+        this->slab_cube_offsets[i] += this->slab_cube_offsets[i-1];
+        this->slab_triangle_offsets[i] += this->slab_triangle_offsets[i-1];
+    }
+
+    // fill the cube table
+    this->cube_table.resize(this->slab_cube_offsets[nslabs]);
+    parallel_for(0, nslabs, [&](size_t i) {
+        std::vector<uint8_t> cubeindices(nrcubes);
+        std::vector<uint64_t> active(nrwords);
+        std::vector<std::pair<size_t, size_t>> ranges;
+        std::vector<float> rowbuffer;
+        size_t pos = this->slab_cube_offsets[i];
+        for(size_t j = 0; j < this->grid_dimensions[1] - 1; j++) {
+            if(this->classify_cubes(j, i, _isovalue, 0, nrcubes, cubeindices.data(), active.data(), ranges, rowbuffer) == 0) {
+                continue;
+            }
+            for(size_t w = 0; w < nrwords; w++) {
+                for(uint64_t bits = active[w]; bits; bits &= bits - 1) {
+                    const size_t x = w * 64 + ctz64(bits);
+                    this->cube_table[pos++] = ActiveCube((i * this->grid_dimensions[1] + j) * this->grid_dimensions[0] + x,
+                                                         cubeindices[x]);
                 }
             }
         }
+    }, Schedule::DYNAMIC);
+}
+
+/**
+ * @brief      classify (a part of) a row of cubes along x, skipping all
+ *             bricks which do not straddle the isovalue
+ *
+ * Only the active bits of the words overlapping [_begin, _end) are cleared
+ * and only the grid points within this part of the row are read.
+ *
+ * @param[in]  _j            y index of the row
+ * @param[in]  _i            z index of the row
+ * @param[in]  _isovalue     The isovalue
+ * @param[in]  _begin        first cube of the row to classify
+ * @param[in]  _end          one past the last cube of the row to classify
+ * @param      _cubeindices  cube index for every cube of the row
+ * @param      _active       bitmask of active cubes
+ * @param      _ranges       scratch space for the active ranges
+ * @param      _rowbuffer    scratch space for rows which are not stored
+ *                           in single precision
+ *
+ * @return     number of active cubes
+ */
+size_t IsoSurface::classify_cubes(size_t _j, size_t _i, float _isovalue, size_t _begin, size_t _end,
+                                  uint8_t* _cubeindices, uint64_t* _active,
+                                  std::vector<std::pair<size_t, size_t>>& _ranges,
+                                  std::vector<float>& _rowbuffer) const {
+    const size_t nx = this->grid_dimensions[0];
+    std::fill(_active + _begin / 64, _active + (_end + 63) / 64, 0);
+
+    this->vp_ptr->get_active_ranges(_j, _i, _isovalue, _begin, _end, _ranges);
+    if(_ranges.empty()) {
+        return 0;
+    }
+
+    if(this->vp_ptr->get_dtype() != ScalarType::FLOAT32) {
+        _rowbuffer.resize(4 * nx);
+    }
+    const float* rows[4] = {
+        this->vp_ptr->get_row(_j, _i, _rowbuffer.data(), _begin, _end + 1),
+        this->vp_ptr->get_row(_j+1, _i, _rowbuffer.data() + nx, _begin, _end + 1),
+        this->vp_ptr->get_row(_j, _i+1, _rowbuffer.data() + 2 * nx, _begin, _end + 1),
+        this->vp_ptr->get_row(_j+1, _i+1, _rowbuffer.data() + 3 * nx, _begin, _end + 1)
+    };
+
+    size_t nractive = 0;
+    for(const auto& range : _ranges) {
+        nractive += classify_cube_row(rows, range.first, range.second, _isovalue, _cubeindices, _active);
     }
+
+    return nractive;
 }
 
-void IsoSurface::sample_grid_with_tetrahedra(float _isovalue) {
-    for(size_t i = 0; i < this->grid_dimensions[2] - 1; i++) {
+/**
+ * @brief      count the number of triangles generated by the tetrahedra
+ *             of every slab
+ *
+ * The tetrahedra are not stored; they are reconstructed in place when the
+ * triangles are built (see construct_triangles_from_tetrahedra).
+ *
+ * @param[in]  _isovalue  The isovalue
+ *
+ * @return     number of tetrahedra intersected by the isosurface
+ */
+uint64_t IsoSurface::sample_grid_with_tetrahedra(float _isovalue) {
+    const size_t nslabs = this->grid_dimensions[2] - 1;
+    this->slab_triangle_offsets.assign(nslabs + 1, 0);
+    std::atomic<uint64_t> nractive(0);
+
+    parallel_for(0, nslabs, [&](size_t i) {
+        size_t nrtriangles = 0;
+        size_t nrtetrahedra = 0;
         for(size_t j = 0; j < this->grid_dimensions[1] - 1; j++) {
             for(size_t k = 0; k < this->grid_dimensions[0] - 1; k++) {
                 for(size_t l=0; l<6; l++) {
                     Tetrahedron tet(k, j, i, *this->vp_ptr, l);
                     tet.set_tetrahedron_index(_isovalue);
-                    if(!(tet.get_tetrahedron_index() == (size_t)0 ||
-                             tet.get_tetrahedron_index() == (size_t)15)) {
-                        this->tetrahedra_table.push_back(tet);
-                    }
+                    const size_t count = tetrahedron_triangle_count_table[tet.get_tetrahedron_index()];
+                    nrtriangles += count;
+                    nrtetrahedra += (count != 0);
                 }
             }
         }
+        this->slab_triangle_offsets[i+1] = nrtriangles;
+        nractive += nrtetrahedra;
+    }, Schedule::DYNAMIC);
+
+    // exclusive scan over the slabs
+    for(size_t i = 1; i <= nslabs; i++) {
+        this->slab_triangle_offsets[i] += this->slab_triangle_offsets[i-1];
     }
+
+    return nractive;
 }
 
-void IsoSurface::construct_triangles_from_cubes(float _isovalue) {
-    std::mutex push_back_mutex;
-
-    #pragma omp parallel for schedule(dynamic)
-    for(size_t i=0; i < cube_table.size(); i++) {
-
-        uint8_t cubeindex = cube_table[i].get_cube_index();
-        Vec3 vertices_list[12];
-
-        /* Find the vertices where the surface intersects the cube, perform
-        an interpolation of 2 (Vec3) coordinates and 2 values and the isovalue,
-        return one (Vec3) coordinate as the result */
-        if (edge_table[cubeindex] & (1 << 0))
-            vertices_list[0] =
-                this->interpolate_from_cubes(cube_table[i], 0, 1, _isovalue);
-        if (edge_table[cubeindex] & (1 << 1))
-            vertices_list[1] =
-                this->interpolate_from_cubes(cube_table[i], 1, 2, _isovalue);
-        if (edge_table[cubeindex] & (1 << 2))
-            vertices_list[2] =
-                this->interpolate_from_cubes(cube_table[i], 2, 3, _isovalue);
-        if (edge_table[cubeindex] & (1 << 3))
-            vertices_list[3] =
-                this->interpolate_from_cubes(cube_table[i], 3, 0, _isovalue);
-        if (edge_table[cubeindex] & (1 << 4))
-            vertices_list[4] =
-                this->interpolate_from_cubes(cube_table[i], 4, 5, _isovalue);
-        if (edge_table[cubeindex] & (1 << 5))
-            vertices_list[5] =
-                this->interpolate_from_cubes(cube_table[i], 5, 6, _isovalue);
-        if (edge_table[cubeindex] & (1 << 6))
-            vertices_list[6] =
-                this->interpolate_from_cubes(cube_table[i], 6, 7, _isovalue);
-        if (edge_table[cubeindex] & (1 << 7))
-            vertices_list[7] =
-                this->interpolate_from_cubes(cube_table[i], 7, 4, _isovalue);
-        if (edge_table[cubeindex] & (1 << 8))
-            vertices_list[8] =
-                this->interpolate_from_cubes(cube_table[i], 0, 4, _isovalue);
-        if (edge_table[cubeindex] & (1 << 9))
-            vertices_list[9] =
-                this->interpolate_from_cubes(cube_table[i], 1, 5, _isovalue);
-        if (edge_table[cubeindex] & (1 << 10))
-            vertices_list[10] =
-                this->interpolate_from_cubes(cube_table[i], 2, 6, _isovalue);
-        if (edge_table[cubeindex] & (1 << 11))
-            vertices_list[11] =
-                this->interpolate_from_cubes(cube_table[i], 3, 7, _isovalue);
-
-        /* finally construct the triangles using the triangle table */
-        for(size_t i=0; triangle_table[cubeindex][i] != -1; i += 3) {
-            Triangle triangle(
-                    vertices_list[triangle_table[cubeindex][i]],
-                    vertices_list[triangle_table[cubeindex][i+1]],
-                    vertices_list[triangle_table[cubeindex][i+2]]);
-            /* push the triangle to the list */
-            push_back_mutex.lock();
-            this->triangles.push_back(triangle);
-            push_back_mutex.unlock();
-        }
-    }
-}
-
-void IsoSurface::construct_triangles_from_tetrahedra(float _isovalue) {
-    for(size_t i=0; i < tetrahedra_table.size(); i++) {
-
-        size_t tetidx = tetrahedra_table[i].get_tetrahedron_index();
-        Vec3 p[3];
-
-        switch(tetidx) {
-            case 0x0E:
-            case 0x01:
-                p[0] = this->interpolate_from_tetrahedra(tetrahedra_table[i], 0, 1, _isovalue);
-                p[1] = this->interpolate_from_tetrahedra(tetrahedra_table[i], 0, 2, _isovalue);
-                p[2] = this->interpolate_from_tetrahedra(tetrahedra_table[i], 0, 3, _isovalue);
-                this->triangles.push_back(Triangle(p[0], p[1], p[2]));
-                break;
-            case 0x0D:
-            case 0x02:
-                p[0] = this->interpolate_from_tetrahedra(tetrahedra_table[i], 1, 0, _isovalue);
-                p[1] = this->interpolate_from_tetrahedra(tetrahedra_table[i], 1, 3, _isovalue);
-                p[2] = this->interpolate_from_tetrahedra(tetrahedra_table[i], 1, 2, _isovalue);
-                this->triangles.push_back(Triangle(p[0], p[1], p[2]));
-                break;
-            case 0x0C:
-            case 0x03:
-                p[0] = this->interpolate_from_tetrahedra(tetrahedra_table[i], 0, 3, _isovalue);
-                p[1] = this->interpolate_from_tetrahedra(tetrahedra_table[i], 0, 2, _isovalue);
-                p[2] = this->interpolate_from_tetrahedra(tetrahedra_table[i], 1, 3, _isovalue);
-                this->triangles.push_back(Triangle(p[0], p[1], p[2]));
-
-                p[0] = this->interpolate_from_tetrahedra(tetrahedra_table[i], 1, 2, _isovalue);
-                this->triangles.push_back(Triangle(p[2], p[0], p[1]));
-
-                break;
-            case 0x0B:
-            case 0x04:
-                p[0] = this->interpolate_from_tetrahedra(tetrahedra_table[i], 2, 0, _isovalue);
-                p[1] = this->interpolate_from_tetrahedra(tetrahedra_table[i], 2, 1, _isovalue);
-                p[2] = this->interpolate_from_tetrahedra(tetrahedra_table[i], 2, 3, _isovalue);
-                this->triangles.push_back(Triangle(p[0], p[1], p[2]));
-                break;
-            case 0x0A:
-            case 0x05:
-                p[0] = this->interpolate_from_tetrahedra(tetrahedra_table[i], 0, 1, _isovalue);
-                p[1] = this->interpolate_from_tetrahedra(tetrahedra_table[i], 2, 3, _isovalue);
-                p[2] = this->interpolate_from_tetrahedra(tetrahedra_table[i], 0, 3, _isovalue);
-                this->triangles.push_back(Triangle(p[0], p[1], p[2]));
-                p[2] = this->interpolate_from_tetrahedra(tetrahedra_table[i], 1, 2, _isovalue);
-                this->triangles.push_back(Triangle(p[0], p[2], p[1]));
-                break;
-            case 0x09:
-            case 0x06:
-                p[0] = this->interpolate_from_tetrahedra(tetrahedra_table[i], 0, 1, _isovalue);
-                p[1] = this->interpolate_from_tetrahedra(tetrahedra_table[i], 1, 3, _isovalue);
-                p[2] = this->interpolate_from_tetrahedra(tetrahedra_table[i], 2, 3, _isovalue);
-                this->triangles.push_back(Triangle(p[0], p[1], p[2]));
-                p[1] = this->interpolate_from_tetrahedra(tetrahedra_table[i], 0, 2, _isovalue);
-                this->triangles.push_back(Triangle(p[0], p[1], p[2]));
-                break;
-            case 0x07:
-            case 0x08:
-                p[0] = this->interpolate_from_tetrahedra(tetrahedra_table[i], 3, 0, _isovalue);
-                p[1] = this->interpolate_from_tetrahedra(tetrahedra_table[i], 3, 2, _isovalue);
-                p[2] = this->interpolate_from_tetrahedra(tetrahedra_table[i], 3, 1, _isovalue);
-                this->triangles.push_back(Triangle(p[0], p[1], p[2]));
-        break;
+/**
+ * @brief      construct the triangles for all active cubes
+ *
+ * Uses the per-slab offsets established by sample_grid_with_cubes such that
+ * every slab writes its triangles to a preallocated and disjoint part of the
+ * index buffer.
+ *
+ * @return     number of searches in the vertex table
+ */
+uint64_t IsoSurface::construct_triangles_from_cubes() {
+    const size_t nslabs = this->slab_cube_offsets.size() - 1;
+    const uint64_t nx = this->grid_dimensions[0];
+    const uint64_t planesize = nx * this->grid_dimensions[1];
+    this->indices.resize(this->slab_triangle_offsets[nslabs] * 3);
+
+    uint64_t edge_offsets[12];
+    uint8_t edge_directions[12];
+    get_cube_edge_offsets(nx, planesize, edge_offsets, edge_directions);
+    std::atomic<uint64_t> nrlookups(0);
+
+    parallel_for(0, nslabs, [&](size_t s) {
+        size_t pos = this->slab_triangle_offsets[s] * 3;
+        size_t nrsearches = 0;
+        for(size_t i=this->slab_cube_offsets[s]; i < this->slab_cube_offsets[s+1]; i++) {
+            const uint64_t idx = this->cube_table[i].get_grid_index();
+            const uint8_t cubeindex = this->cube_table[i].get_cube_index();
+            size_t vertices_list[12];
+
+            /* Find the vertices where the surface intersects the cube; each
+            intersected edge refers to a single vertex in the vertex table */
+            for(size_t e=0; e<12; e++) {
+                if(edge_table[cubeindex] & (1 << e)) {
+                    vertices_list[e] = this->get_vertex_index((idx + edge_offsets[e]) * EDGE_DIRECTIONS +
+                                                              edge_directions[e]);
+                    nrsearches++;
+                }
+            }
+
+            /* finally construct the triangles using the triangle table */
+            for(size_t t=0; triangle_table[cubeindex][t] != -1; t++) {
+                this->indices[pos++] = vertices_list[triangle_table[cubeindex][t]];
+            }
+        }
+        nrlookups += nrsearches;
+    }, Schedule::DYNAMIC);
+
+    return nrlookups;
+}
+
+/**
+ * @brief      construct the triangles of all cubes between two z-planes as
+ *             a triangle soup
+ *
+ * The vertices of the edges along the four grid rows spanning a row of
+ * cubes are cached, such that every edge is only interpolated once per
+ * slab. The normal of a triangle is the negative gradient of the trilinear
+ * interpolation of the cube at the centroid of the triangle, which only
+ * requires the values at the corners of the cube.
+ *
+ * @param[in]  _z         z-coordinate of the bottom plane
+ * @param[in]  _isovalue  The isovalue
+ * @param      _vertices  three vertices per triangle
+ * @param      _normals   normal per triangle
+ */
+void IsoSurface::triangulate_slab(size_t _z, float _isovalue, std::vector<Vec3>& _vertices,
+                                  std::vector<Vec3>& _normals) const {
+    const uint64_t nx = this->grid_dimensions[0];
+    const uint64_t ny = this->grid_dimensions[1];
+    const size_t nrcubes = nx - 1;
+    const size_t nrwords = (nrcubes + 63) / 64;
+    _vertices.clear();
+    _normals.clear();
+
+    // a row of grid points is cached in the slot given by the parity of its
+    // y-coordinate and its plane; a cached vertex is valid when its stamp
+    // equals the y-coordinate (+1) of its row
+    std::vector<Vec3> cache(4 * nx * 3);
+    std::vector<size_t> stamps(4 * nx * 3, 0);
+
+    std::vector<uint8_t> cubeindices(nrcubes);
+    std::vector<uint64_t> active(nrwords);
+    std::vector<std::pair<size_t, size_t>> ranges;
+    std::vector<float> rowbuffer;
+    for(size_t j = 0; j < ny - 1; j++) {
+        if(this->classify_cubes(j, _z, _isovalue, 0, nrcubes, cubeindices.data(), active.data(), ranges, rowbuffer) == 0) {
+            continue;
+        }
+        for(size_t w = 0; w < nrwords; w++) {
+            for(uint64_t bits = active[w]; bits; bits &= bits - 1) {
+                const size_t x = w * 64 + ctz64(bits);
+                const uint8_t cubeindex = cubeindices[x];
+
+                // values at the corners of the cube, indexed by (dx, dy, dz)
+                float c[2][2][2];
+                for(size_t k=0; k<8; k++) {
+                    c[k & 1][(k >> 1) & 1][k >> 2] = this->vp_ptr->get_value(x + (k & 1), j + ((k >> 1) & 1), _z + (k >> 2));
+                }
+
+                // vertex (in the cache) and position within the cube of
+                // every intersected edge
+                size_t slots[12];
+                Vec3 local[12];
+                for(size_t e=0; e<12; e++) {
+                    if(!(edge_table[cubeindex] & (1 << e))) {
+                        continue;
+                    }
+                    const uint8_t* loc = cube_edge_plane_table[e];
+                    const size_t y = j + loc[2];
+                    slots[e] = (((y & 1) + 2 * loc[0]) * nx + x + loc[1]) * 3 + loc[3];
+                    if(stamps[slots[e]] != y + 1) {
+                        const uint64_t idx = ((_z + loc[0]) * ny + y) * nx + x + loc[1];
+                        this->interpolate_vertex(idx * EDGE_DIRECTIONS + cube_edge_directions[loc[3]], _isovalue,
+                                                 &cache[slots[e]], nullptr);
+                        stamps[slots[e]] = y + 1;
+                    }
+
+                    size_t p1[3] = {loc[1], loc[2], loc[0]};
+                    size_t p2[3] = {loc[1], loc[2], loc[0]};
+                    p2[loc[3]]++;
+                    const float v1 = c[p1[0]][p1[1]][p1[2]];
+                    const float v2 = c[p2[0]][p2[1]][p2[2]];
+                    const float mu = std::abs(v1 - v2) >= PRECISION_LIMIT ? (_isovalue - v1) / (v2 - v1) : 0.5f;
+                    local[e] = Vec3((float)p1[0], (float)p1[1], (float)p1[2]);
+                    (&local[e].x)[loc[3]] += mu;
+                }
+
+                for(size_t t=0; triangle_table[cubeindex][t] != -1; t+=3) {
+                    const size_t e1 = triangle_table[cubeindex][t];
+                    const size_t e2 = triangle_table[cubeindex][t+1];
+                    const size_t e3 = triangle_table[cubeindex][t+2];
+
+                    // gradient of the trilinear interpolation at the centroid
+                    const Vec3 u = (local[e1] + local[e2] + local[e3]) / 3.0f;
+                    const float wx[2] = {1.0f - u.x, u.x};
+                    const float wy[2] = {1.0f - u.y, u.y};
+                    const float wz[2] = {1.0f - u.z, u.z};
+                    Vec3 g(0.0f, 0.0f, 0.0f);
+                    for(size_t a=0; a<2; a++) {
+                        for(size_t b=0; b<2; b++) {
+                            g.x += wy[a] * wz[b] * (c[1][a][b] - c[0][a][b]);
+                            g.y += wx[a] * wz[b] * (c[a][1][b] - c[a][0][b]);
+                            g.z += wx[a] * wy[b] * (c[a][b][1] - c[a][b][0]);
+                        }
+                    }
+
+                    // the negative of the gradient is the correct normal (for
+                    // positive isovalues); fall back to the normal of the
+                    // triangle itself when the gradient vanishes
+                    const Vec3 gradient = this->vp_ptr->gradient_to_realspace(g);
+                    const Vec3& a = cache[slots[e1]];
+                    const Vec3& b = cache[slots[e2]];
+                    const Vec3& d = cache[slots[e3]];
+                    const Vec3 orientation_face = (b - a).cross(d - a);
+                    Vec3 normal = gradient * (_isovalue < 0.0f ? 1.0f : -1.0f);
+                    if(gradient.dot(gradient) == 0.0f) {
+                        normal = orientation_face;
+                    }
+                    const float length = std::sqrt(normal.dot(normal));
+                    normal = length > 0.0f ? normal / length : normal;
+
+                    // put the triangle in the right orientation
+                    if(normal.dot(orientation_face) > 0.0f) {
+                        _vertices.insert(_vertices.end(), {a, b, d});
+                    } else {
+                        _vertices.insert(_vertices.end(), {b, a, d});
+                    }
+                    _normals.push_back(normal);
+                }
+            }
         }
     }
 }
 
-Vec3 IsoSurface::interpolate_from_cubes(const Cube &_cub, size_t _p1,
-    size_t _p2, float _isovalue) {
-    float v1 = _cub.get_value_from_vertex(_p1);
-    float v2 = _cub.get_value_from_vertex(_p2);
+/**
+ * @brief      construct the triangles for all tetrahedra
+ *
+ * Every cell is split into six tetrahedra which are constructed in place;
+ * the triangles of each slab are written to the part of the index buffer
+ * established by sample_grid_with_tetrahedra.
+ *
+ * @param[in]  _isovalue  The isovalue
+ *
+ * @return     number of searches in the vertex table
+ */
+uint64_t IsoSurface::construct_triangles_from_tetrahedra(float _isovalue) {
+    const size_t nslabs = this->slab_triangle_offsets.size() - 1;
+    this->indices.resize(this->slab_triangle_offsets[nslabs] * 3);
+    std::atomic<uint64_t> nrlookups(0);
+
+    parallel_for(0, nslabs, [&](size_t i) {
+        size_t pos = this->slab_triangle_offsets[i] * 3;
+        size_t nrsearches = 0;
+        for(size_t j = 0; j < this->grid_dimensions[1] - 1; j++) {
+            for(size_t k = 0; k < this->grid_dimensions[0] - 1; k++) {
+                for(size_t l=0; l<6; l++) {
+                    Tetrahedron tet(k, j, i, *this->vp_ptr, l);
+                    tet.set_tetrahedron_index(_isovalue);
+                    const size_t n = this->triangles_from_tetrahedron(tet, this->indices.data() + pos);
+                    pos += n;
+
+                    // a single triangle has three vertices, two triangles
+                    // share two of their four vertices
+                    nrsearches += (n == 6) ? 4 : n;
+                }
+            }
+        }
+        nrlookups += nrsearches;
+    }, Schedule::DYNAMIC);
 
-    Vec3 p1 = _cub.get_position_from_vertex(_p1);
-    Vec3 p2 = _cub.get_position_from_vertex(_p2);
+    return nrlookups;
+}
 
-    Vec3 p;
-    float mu;
+/**
+ * @brief      build the triangles of a single tetrahedron
+ *
+ * @param[in]  _tet      The tetrahedron
+ * @param      _indices  output buffer for the triangle indices
+ *
+ * @return     number of indices written
+ */
+size_t IsoSurface::triangles_from_tetrahedron(const Tetrahedron &_tet, size_t* _indices) const {
+    const size_t tetidx = _tet.get_tetrahedron_index();
+    size_t p[3];
+    size_t n = 0;
 
-    if(std::abs(_isovalue-v1) < PRECISION_LIMIT)
-        return p1;
-    if(std::abs(_isovalue-v2) < PRECISION_LIMIT)
-        return p2;
-    if(std::abs(v1-v2) < PRECISION_LIMIT)
-        return p1;
+    switch(tetidx) {
+        case 0x0E:
+        case 0x01:
+            p[0] = this->vertex_from_tetrahedra(_tet, 0, 1);
+            p[1] = this->vertex_from_tetrahedra(_tet, 0, 2);
+            p[2] = this->vertex_from_tetrahedra(_tet, 0, 3);
+            _indices[n++] = p[0]; _indices[n++] = p[1]; _indices[n++] = p[2];
+            break;
+        case 0x0D:
+        case 0x02:
+            p[0] = this->vertex_from_tetrahedra(_tet, 1, 0);
+            p[1] = this->vertex_from_tetrahedra(_tet, 1, 3);
+            p[2] = this->vertex_from_tetrahedra(_tet, 1, 2);
+            _indices[n++] = p[0]; _indices[n++] = p[1]; _indices[n++] = p[2];
+            break;
+        case 0x0C:
+        case 0x03:
+            p[0] = this->vertex_from_tetrahedra(_tet, 0, 3);
+            p[1] = this->vertex_from_tetrahedra(_tet, 0, 2);
+            p[2] = this->vertex_from_tetrahedra(_tet, 1, 3);
+            _indices[n++] = p[0]; _indices[n++] = p[1]; _indices[n++] = p[2];
 
-    mu = (_isovalue - v1) / (v2 - v1);
+            p[0] = this->vertex_from_tetrahedra(_tet, 1, 2);
+            _indices[n++] = p[2]; _indices[n++] = p[0]; _indices[n++] = p[1];
 
-    p.x = p1.x + mu * (p2.x - p1.x);
-    p.y = p1.y + mu * (p2.y - p1.y);
-    p.z = p1.z + mu * (p2.z - p1.z);
+            break;
+        case 0x0B:
+        case 0x04:
+            p[0] = this->vertex_from_tetrahedra(_tet, 2, 0);
+            p[1] = this->vertex_from_tetrahedra(_tet, 2, 1);
+            p[2] = this->vertex_from_tetrahedra(_tet, 2, 3);
+            _indices[n++] = p[0]; _indices[n++] = p[1]; _indices[n++] = p[2];
+            break;
+        case 0x0A:
+        case 0x05:
+            p[0] = this->vertex_from_tetrahedra(_tet, 0, 1);
+            p[1] = this->vertex_from_tetrahedra(_tet, 2, 3);
+            p[2] = this->vertex_from_tetrahedra(_tet, 0, 3);
+            _indices[n++] = p[0]; _indices[n++] = p[1]; _indices[n++] = p[2];
+            p[2] = this->vertex_from_tetrahedra(_tet, 1, 2);
+            _indices[n++] = p[0]; _indices[n++] = p[2]; _indices[n++] = p[1];
+            break;
+        case 0x09:
+        case 0x06:
+            p[0] = this->vertex_from_tetrahedra(_tet, 0, 1);
+            p[1] = this->vertex_from_tetrahedra(_tet, 1, 3);
+            p[2] = this->vertex_from_tetrahedra(_tet, 2, 3);
+            _indices[n++] = p[0]; _indices[n++] = p[1]; _indices[n++] = p[2];
+            p[1] = this->vertex_from_tetrahedra(_tet, 0, 2);
+            _indices[n++] = p[0]; _indices[n++] = p[1]; _indices[n++] = p[2];
+            break;
+        case 0x07:
+        case 0x08:
+            p[0] = this->vertex_from_tetrahedra(_tet, 3, 0);
+            p[1] = this->vertex_from_tetrahedra(_tet, 3, 2);
+            p[2] = this->vertex_from_tetrahedra(_tet, 3, 1);
+            _indices[n++] = p[0]; _indices[n++] = p[1]; _indices[n++] = p[2];
+            break;
+    }
 
-    return p;
+    return n;
 }
 
-Vec3 IsoSurface::interpolate_from_tetrahedra(const Tetrahedron &_tet,
-    size_t _p1, size_t _p2, float _isovalue) {
-    float v1 = _tet.get_value_from_vertex(_p1);
-    float v2 = _tet.get_value_from_vertex(_p2);
+/**
+ * @brief      first pass of the flying edges algorithm: classify all grid
+ *             points and count the intersected x-edges of every row
+ *
+ * @param[in]  _isovalue  The isovalue
+ */
+void IsoSurface::flying_edges_classify(float _isovalue) {
+    const size_t nx = this->grid_dimensions[0];
+    const size_t ny = this->grid_dimensions[1];
+    const size_t nrows = ny * this->grid_dimensions[2];
+
+    this->point_cases.resize(nx * nrows);
+    this->edge_rows.assign(nrows * FE_ROW_SIZE, 0);
+
+    parallel_for(0, nrows, [&](size_t r) {
+        std::vector<float> rowbuffer(this->vp_ptr->get_dtype() == ScalarType::FLOAT32 ? 0 : nx);
+        const float* values = this->vp_ptr->get_row(r % ny, r / ny, rowbuffer.data());
+        uint8_t* cases = &this->point_cases[r * nx];
+        size_t* row = &this->edge_rows[r * FE_ROW_SIZE];
+
+        for(size_t x=0; x<nx; x++) {
+            cases[x] = values[x] < _isovalue;
+        }
 
-    Vec3 p1 = _tet.get_position_from_vertex(_p1);
-    Vec3 p2 = _tet.get_position_from_vertex(_p2);
+        row[FE_XMIN] = nx - 1;
+        row[FE_XMAX] = 0;
+        for(size_t x=0; x<nx-1; x++) {
+            if(cases[x] != cases[x+1]) {
+                row[FE_XMIN] = std::min(row[FE_XMIN], x);
+                row[FE_XMAX] = x + 1;
+                row[FE_XEDGES]++;
+            }
+        }
+    }, Schedule::STATIC);
+}
 
-    Vec3 p;
-    float mu;
+/**
+ * @brief      second pass of the flying edges algorithm: count the
+ *             intersected y- and z-edges and the triangles of every row
+ */
+void IsoSurface::flying_edges_count() {
+    const size_t nx = this->grid_dimensions[0];
+    const size_t ny = this->grid_dimensions[1];
+    const size_t nz = this->grid_dimensions[2];
 
-    if(std::abs(_isovalue-v1) < PRECISION_LIMIT)
-        return p1;
-    if(std::abs(_isovalue-v2) < PRECISION_LIMIT)
-        return p2;
-    if(std::abs(v1-v2) < PRECISION_LIMIT)
-        return p1;
+    parallel_for(0, ny*nz, [&](size_t r) {
+        const size_t y = r % ny;
+        const size_t z = r / ny;
+        size_t* row = &this->edge_rows[r * FE_ROW_SIZE];
 
-    mu = (_isovalue - v1) / (v2 - v1);
+        this->flying_edges_trim(y, z, row[FE_LEFT], row[FE_RIGHT]);
+        if(row[FE_LEFT] >= row[FE_RIGHT]) {
+            return;
+        }
 
-    p.x = p1.x + mu * (p2.x - p1.x);
-    p.y = p1.y + mu * (p2.y - p1.y);
-    p.z = p1.z + mu * (p2.z - p1.z);
+        const uint8_t* cases[4] = {
+            &this->point_cases[r * nx],
+            y+1 < ny ? &this->point_cases[(r+1) * nx] : nullptr,
+            z+1 < nz ? &this->point_cases[(r+ny) * nx] : nullptr,
+            y+1 < ny && z+1 < nz ? &this->point_cases[(r+ny+1) * nx] : nullptr
+        };
 
-    return p;
+        for(size_t x=row[FE_LEFT]; x<=row[FE_RIGHT]; x++) {
+            if(cases[1] && cases[0][x] != cases[1][x]) {
+                row[FE_YEDGES]++;
+            }
+            if(cases[2] && cases[0][x] != cases[2][x]) {
+                row[FE_ZEDGES]++;
+            }
+        }
+
+        if(cases[3]) {
+            for(size_t x=row[FE_LEFT]; x<row[FE_RIGHT]; x++) {
+                row[FE_TRIANGLES] += triangle_count_table[flying_edges_cube_index(cases, x)];
+            }
+        }
+    }, Schedule::STATIC);
+}
+
+/**
+ * @brief      fourth pass of the flying edges algorithm: calculate the
+ *             vertices on the intersected edges of every row, ordered by
+ *             axis and position along x
+ *
+ * @param[in]  _isovalue  The isovalue
+ */
+void IsoSurface::flying_edges_vertices(float _isovalue) {
+    const size_t nx = this->grid_dimensions[0];
+    const size_t ny = this->grid_dimensions[1];
+    const size_t nz = this->grid_dimensions[2];
+    const size_t neighbours[3] = {1, nx, nx * ny};
+
+    parallel_for(0, ny*nz, [&](size_t r) {
+        const size_t* row = &this->edge_rows[r * FE_ROW_SIZE];
+        const bool has_neighbour[3] = {true, r % ny + 1 < ny, r / ny + 1 < nz};
+        const size_t begin[3] = {row[FE_XMIN], row[FE_LEFT], row[FE_LEFT]};
+        const size_t end[3] = {row[FE_XMAX], row[FE_RIGHT] + 1, row[FE_RIGHT] + 1};
+
+        for(size_t a=0; a<3; a++) {
+            if(!has_neighbour[a]) {
+                continue;
+            }
+            size_t pos = row[FE_XEDGES + a];
+            for(size_t x=begin[a]; x<end[a]; x++) {
+                const size_t idx = r * nx + x;
+                if(this->point_cases[idx] != this->point_cases[idx + neighbours[a]]) {
+                    this->store_vertex(pos++, idx * EDGE_DIRECTIONS + cube_edge_directions[a], _isovalue);
+                }
+            }
+        }
+    }, Schedule::STATIC);
+}
+
+/**
+ * @brief      fourth pass of the flying edges algorithm: construct the
+ *             triangles of every row of cubes
+ *
+ * While moving along x, a running vertex index is kept for the edges of
+ * each of the four grid rows spanning the row of cubes. Because the rows
+ * are trimmed, no edge in front of the trimmed range is intersected and the
+ * running indices start at the first vertex of their row and axis.
+ *
+ * @return     number of cubes intersected by the isosurface
+ */
+uint64_t IsoSurface::flying_edges_triangles() {
+    const size_t nx = this->grid_dimensions[0];
+    const size_t ny = this->grid_dimensions[1];
+    const size_t nz = this->grid_dimensions[2];
+    std::atomic<uint64_t> nractive(0);
+
+    parallel_for(0, ny*nz, [&](size_t r) {
+        const size_t* row = &this->edge_rows[r * FE_ROW_SIZE];
+        if(r % ny + 1 >= ny || r / ny + 1 >= nz || row[FE_LEFT] >= row[FE_RIGHT]) {
+            return;
+        }
+
+        const size_t rows[4] = {r, r+1, r+ny, r+ny+1};
+        const uint8_t* cases[4];
+        size_t counters[4][3];
+        for(size_t q=0; q<4; q++) {
+            cases[q] = &this->point_cases[rows[q] * nx];
+            for(size_t a=0; a<3; a++) {
+                counters[q][a] = this->edge_rows[rows[q] * FE_ROW_SIZE + FE_XEDGES + a];
+            }
+        }
+
+        size_t pos = row[FE_TRIANGLES] * 3;
+        size_t nrcubes = 0;
+        for(size_t x=row[FE_LEFT]; x<row[FE_RIGHT]; x++) {
+            // whether the edges of the four rows at x are intersected
+            uint8_t crossed[4][3] = {};
+            for(size_t q=0; q<4; q++) {
+                crossed[q][0] = cases[q][x] != cases[q][x+1];
+            }
+            crossed[0][1] = cases[0][x] != cases[1][x];
+            crossed[2][1] = cases[2][x] != cases[3][x];
+            crossed[0][2] = cases[0][x] != cases[2][x];
+            crossed[1][2] = cases[1][x] != cases[3][x];
+
+            const uint8_t cubeindex = flying_edges_cube_index(cases, x);
+            if(edge_table[cubeindex] != 0) {
+                nrcubes++;
+                size_t vertices_list[12];
+                for(size_t e=0; e<12; e++) {
+                    if(edge_table[cubeindex] & (1 << e)) {
+                        const uint8_t* loc = cube_edge_row_table[e];
+                        vertices_list[e] = counters[loc[0]][loc[1]] + (loc[2] ? crossed[loc[0]][loc[1]] : 0);
+                    }
+                }
+
+                for(size_t t=0; triangle_table[cubeindex][t] != -1; t++) {
+                    this->indices[pos++] = vertices_list[triangle_table[cubeindex][t]];
+                }
+            }
+
+            for(size_t q=0; q<4; q++) {
+                for(size_t a=0; a<3; a++) {
+                    counters[q][a] += crossed[q][a];
+                }
+            }
+        }
+        nractive += nrcubes;
+    }, Schedule::STATIC);
+
+    return nractive;
+}
+
+/**
+ * @brief      determine the range of grid points along x which needs to be
+ *             visited for a grid row and its neighbours in +y and +z
+ *
+ * Outside the range spanned by the intersected x-edges, every row has a
+ * constant classification. Unless these classifications differ between
+ * the rows, no y- or z-edges are intersected and no cubes are active
+ * outside that range.
+ *
+ * @param[in]  _y      y index of the row
+ * @param[in]  _z      z index of the row
+ * @param      _left   first grid point (or cube) to visit
+ * @param      _right  last grid point to visit (one past the last cube)
+ */
+void IsoSurface::flying_edges_trim(size_t _y, size_t _z, size_t& _left, size_t& _right) const {
+    const size_t nx = this->grid_dimensions[0];
+    const size_t ny = this->grid_dimensions[1];
+    const size_t r = _z * ny + _y;
+
+    size_t rows[4] = {r};
+    size_t nrrows = 1;
+    if(_y + 1 < ny) {
+        rows[nrrows++] = r + 1;
+    }
+    if(_z + 1 < this->grid_dimensions[2]) {
+        rows[nrrows++] = r + ny;
+        if(_y + 1 < ny) {
+            rows[nrrows++] = r + ny + 1;
+        }
+    }
+
+    _left = nx - 1;
+    _right = 0;
+    for(size_t i=0; i<nrrows; i++) {
+        _left = std::min(_left, this->edge_rows[rows[i] * FE_ROW_SIZE + FE_XMIN]);
+        _right = std::max(_right, this->edge_rows[rows[i] * FE_ROW_SIZE + FE_XMAX]);
+        if(this->point_cases[rows[i] * nx] != this->point_cases[r * nx]) {
+            _left = 0;
+        }
+        if(this->point_cases[rows[i] * nx + nx - 1] != this->point_cases[r * nx + nx - 1]) {
+            _right = nx - 1;
+        }
+    }
+}
+
+/**
+ * @brief      prepare the streaming marching cubes algorithm: allocate the
+ *             per-plane scratch space and emit the vertices of the first
+ *             plane of grid points
+ *
+ * @param[in]  _isovalue    The isovalue
+ * @param[in]  _max_planes  maximum number of grid planes resident while
+ *                          building the brick table (0: no limit)
+ */
+void IsoSurface::begin_streaming(float _isovalue, size_t _max_planes) {
+    const size_t planesize = this->grid_dimensions[0] * this->grid_dimensions[1];
+
+    this->stats.clear();
+    PhaseTimer timer(this->stats, "brick_table");
+    this->isovalue = _isovalue;
+    this->cube_table.clear();
+    this->edge_ids.clear();
+    this->row_offsets.clear();
+    this->vertices.clear();
+    this->normals.clear();
+    this->indices.clear();
+
+    this->vp_ptr->build_bricks(_max_planes);
+
+    timer.next("vertices");
+    this->plane_edges[0].assign(planesize * 3, 0);
+    this->plane_edges[1].assign(planesize * 3, 0);
+    this->stream_cubeindices.assign((this->grid_dimensions[0] - 1) * (this->grid_dimensions[1] - 1), 0);
+    this->stream_active.assign(((this->grid_dimensions[0] + 62) / 64) * (this->grid_dimensions[1] - 1), 0);
+    this->stream_offsets.assign(this->grid_dimensions[1] + 1, 0);
+
+    this->stream_vertices(0, _isovalue, this->plane_edges[0], this->stream_offsets);
+}
+
+/**
+ * @brief      emit the vertices of the next plane of grid points and the
+ *             triangles of the slab below it
+ *
+ * @param[in]  _z         z index of the slab
+ * @param[in]  _classify  whether to classify the cubes of the slab; false
+ *                        when they have already been classified (see
+ *                        stream_classify_levels)
+ */
+void IsoSurface::stream_slab(size_t _z, bool _classify) {
+    PhaseTimer timer(this->stats, "vertices");
+    this->stream_vertices(_z+1, this->isovalue, this->plane_edges[(_z+1) % 2], this->stream_offsets);
+    timer.next("triangles");
+    if(_classify) {
+        this->stats.add_counter("active_cells", this->stream_classify(_z, this->isovalue, this->stream_cubeindices,
+                                                                      this->stream_active));
+    }
+    this->stream_triangles(this->plane_edges[_z % 2], this->plane_edges[(_z+1) % 2],
+                           this->stream_cubeindices, this->stream_active, this->stream_offsets);
+}
+
+/**
+ * @brief      release the scratch space of the streaming algorithm
+ */
+void IsoSurface::end_streaming() {
+    this->record_counters(0, 0);
+    this->release_buffer(this->plane_edges[0]);
+    this->release_buffer(this->plane_edges[1]);
+    this->release_buffer(this->stream_cubeindices);
+    this->release_buffer(this->stream_active);
+    this->release_buffer(this->stream_offsets);
+
+    // the vertices grow plane by plane; trim the excess capacity such that
+    // the mesh taking them over does not retain it
+    if(!this->keep_buffers) {
+        this->vertices.shrink_to_fit();
+        this->normals.shrink_to_fit();
+    }
+}
+
+/**
+ * @brief      emit the vertices on the intersected x-, y- and z-edges
+ *             starting from a single plane of grid points
+ *
+ * @param[in]  _z            z-coordinate of the plane
+ * @param[in]  _isovalue     The isovalue
+ * @param      _plane_edges  vertex index per grid point and axis
+ * @param      _row_offsets  scratch space for the per-row offsets
+ */
+void IsoSurface::stream_vertices(size_t _z, float _isovalue, std::vector<size_t>& _plane_edges,
+                                 std::vector<size_t>& _row_offsets) {
+    const size_t nx = this->grid_dimensions[0];
+    const size_t ny = this->grid_dimensions[1];
+    const size_t nz = this->grid_dimensions[2];
+
+    // count the number of intersected edges per row
+    parallel_for(0, ny, [&](size_t y) {
+        std::vector<std::pair<size_t, size_t>> ranges;
+        this->vp_ptr->get_active_ranges(y, _z, _isovalue, 0, nx, ranges);
+        size_t count = 0;
+        for(const auto& range : ranges) {
+            for(size_t x=range.first; x<range.second; x++) {
+                const bool below = this->vp_ptr->get_value(x, y, _z) < _isovalue;
+                for(size_t a=0; a<3; a++) {
+                    const size_t x2 = x + (a == 0), y2 = y + (a == 1), z2 = _z + (a == 2);
+                    if(x2 < nx && y2 < ny && z2 < nz &&
+                       (this->vp_ptr->get_value(x2, y2, z2) < _isovalue) != below) {
+                        count++;
+                    }
+                }
+            }
+        }
+        _row_offsets[y+1] = count;
+    }, Schedule::STATIC);
+
+    _row_offsets[0] = this->vertices.size();
+    for(size_t y=0; y<ny; y++) {
+        _row_offsets[y+1] += _row_offsets[y];
+    }
+    this->vertices.resize(_row_offsets[ny]);
+    this->normals.resize(this->compute_normals ? _row_offsets[ny] : 0);
+
+    // store the vertices
+    parallel_for(0, ny, [&](size_t y) {
+        if(_row_offsets[y+1] == _row_offsets[y]) {
+            return;
+        }
+        std::vector<std::pair<size_t, size_t>> ranges;
+        this->vp_ptr->get_active_ranges(y, _z, _isovalue, 0, nx, ranges);
+        size_t pos = _row_offsets[y];
+        for(const auto& range : ranges) {
+            for(size_t x=range.first; x<range.second; x++) {
+                const bool below = this->vp_ptr->get_value(x, y, _z) < _isovalue;
+                const uint64_t idx = (_z * ny + y) * nx + x;
+                for(size_t a=0; a<3; a++) {
+                    const size_t x2 = x + (a == 0), y2 = y + (a == 1), z2 = _z + (a == 2);
+                    if(x2 < nx && y2 < ny && z2 < nz &&
+                       (this->vp_ptr->get_value(x2, y2, z2) < _isovalue) != below) {
+                        this->store_vertex(pos, idx * EDGE_DIRECTIONS + cube_edge_directions[a], _isovalue);
+                        _plane_edges[(y * nx + x) * 3 + a] = pos++;
+                    }
+                }
+            }
+        }
+    }, Schedule::STATIC);
+}
+
+/**
+ * @brief      classify all cubes between two z-planes
+ *
+ * @param[in]  _z            z-coordinate of the bottom plane
+ * @param[in]  _isovalue     The isovalue
+ * @param      _cubeindices  cube indices of the slab
+ * @param      _active       active cubes of the slab
+ *
+ * @return     number of active cubes
+ */
+uint64_t IsoSurface::stream_classify(size_t _z, float _isovalue, std::vector<uint8_t>& _cubeindices,
+                                     std::vector<uint64_t>& _active) const {
+    const size_t nx = this->grid_dimensions[0];
+    const size_t ny = this->grid_dimensions[1];
+    const size_t nrwords = (nx + 62) / 64;
+
+    std::atomic<uint64_t> nractive(0);
+    parallel_for(0, ny-1, [&](size_t y) {
+        std::vector<std::pair<size_t, size_t>> ranges;
+        std::vector<float> rowbuffer;
+        nractive += this->classify_cubes(y, _z, _isovalue, 0, nx - 1, &_cubeindices[y * (nx-1)],
+                                         &_active[y * nrwords], ranges, rowbuffer);
+    }, Schedule::STATIC);
+
+    return nractive;
+}
+
+/**
+ * @brief      classify all cubes between two z-planes for several
+ *             isovalues at once; every row of grid points is read (and
+ *             converted to single precision) only once for all isovalues
+ *
+ * All isosurfaces need to be streaming over the same scalar field.
+ *
+ * @param[in]  _surfaces  one isosurface per isovalue
+ * @param[in]  _z         z-coordinate of the bottom plane
+ */
+void IsoSurface::stream_classify_levels(const std::vector<std::shared_ptr<IsoSurface>>& _surfaces, size_t _z) {
+    const ScalarField& sf = *_surfaces.front()->vp_ptr;
+    const size_t nx = _surfaces.front()->grid_dimensions[0];
+    const size_t ny = _surfaces.front()->grid_dimensions[1];
+    const size_t nrcubes = nx - 1;
+    const size_t nrwords = (nx + 62) / 64;
+    const size_t nlevels = _surfaces.size();
+
+    std::vector<uint64_t> nractive(nlevels * (ny-1), 0);
+    parallel_for(0, ny-1, [&](size_t y) {
+        // the parts of the row straddling any of the isovalues
+        std::vector<std::vector<std::pair<size_t, size_t>>> ranges(nlevels);
+        size_t begin = nrcubes;
+        size_t end = 0;
+        for(size_t l=0; l<nlevels; l++) {
+            IsoSurface& surface = *_surfaces[l];
+            std::fill(&surface.stream_active[y * nrwords], &surface.stream_active[(y+1) * nrwords], 0);
+            sf.get_active_ranges(y, _z, surface.isovalue, 0, nrcubes, ranges[l]);
+            if(!ranges[l].empty()) {
+                begin = std::min(begin, ranges[l].front().first);
+                end = std::max(end, ranges[l].back().second);
+            }
+        }
+        if(begin >= end) {
+            return;
+        }
+
+        // read the four rows of grid points spanning the cubes once
+        std::vector<float> rowbuffer;
+        if(sf.get_dtype() != ScalarType::FLOAT32) {
+            rowbuffer.resize(4 * nx);
+        }
+        const float* rows[4] = {
+            sf.get_row(y, _z, rowbuffer.data(), begin, end + 1),
+            sf.get_row(y+1, _z, rowbuffer.data() + nx, begin, end + 1),
+            sf.get_row(y, _z+1, rowbuffer.data() + 2 * nx, begin, end + 1),
+            sf.get_row(y+1, _z+1, rowbuffer.data() + 3 * nx, begin, end + 1)
+        };
+
+        for(size_t l=0; l<nlevels; l++) {
+            IsoSurface& surface = *_surfaces[l];
+            for(const auto& range : ranges[l]) {
+                nractive[l * (ny-1) + y] += classify_cube_row(rows, range.first, range.second, surface.isovalue,
+                                                              &surface.stream_cubeindices[y * nrcubes],
+                                                              &surface.stream_active[y * nrwords]);
+            }
+        }
+    }, Schedule::STATIC);
+
+    for(size_t l=0; l<nlevels; l++) {
+        uint64_t total = 0;
+        for(size_t y=0; y<ny-1; y++) {
+            total += nractive[l * (ny-1) + y];
+        }
+        _surfaces[l]->stats.add_counter("active_cells", total);
+    }
+}
+
+/**
+ * @brief      emit the triangles of all (classified) cubes between two
+ *             z-planes
+ *
+ * @param[in]  _bottom_edges  vertex indices of the edges of the bottom plane
+ * @param[in]  _top_edges     vertex indices of the edges of the top plane
+ * @param[in]  _cubeindices   cube indices of the slab
+ * @param[in]  _active        active cubes of the slab
+ * @param      _row_offsets   scratch space for the per-row offsets
+ */
+void IsoSurface::stream_triangles(const std::vector<size_t>& _bottom_edges, const std::vector<size_t>& _top_edges,
+                                  const std::vector<uint8_t>& _cubeindices, const std::vector<uint64_t>& _active,
+                                  std::vector<size_t>& _row_offsets) {
+    const size_t nx = this->grid_dimensions[0];
+    const size_t ny = this->grid_dimensions[1];
+    const size_t nrwords = (nx + 62) / 64;
+    const std::vector<size_t>* planes[2] = {&_bottom_edges, &_top_edges};
+
+    // count the number of triangles per row
+    parallel_for(0, ny-1, [&](size_t y) {
+        const uint8_t* cubeindices = &_cubeindices[y * (nx-1)];
+        const uint64_t* active = &_active[y * nrwords];
+        size_t count = 0;
+        for(size_t w = 0; w < nrwords; w++) {
+            for(uint64_t bits = active[w]; bits; bits &= bits - 1) {
+                count += triangle_count_table[cubeindices[w * 64 + ctz64(bits)]];
+            }
+        }
+        _row_offsets[y+1] = count;
+    }, Schedule::STATIC);
+
+    _row_offsets[0] = this->indices.size() / 3;
+    for(size_t y=0; y<ny-1; y++) {
+        _row_offsets[y+1] += _row_offsets[y];
+    }
+    this->indices.resize(_row_offsets[ny-1] * 3);
+
+    // construct the triangles
+    parallel_for(0, ny-1, [&](size_t y) {
+        size_t pos = _row_offsets[y] * 3;
+        if(_row_offsets[y+1] == _row_offsets[y]) {
+            return;
+        }
+        for(size_t w = 0; w < nrwords; w++) {
+            for(uint64_t bits = _active[y * nrwords + w]; bits; bits &= bits - 1) {
+                const size_t x = w * 64 + ctz64(bits);
+                const uint8_t cubeindex = _cubeindices[y * (nx-1) + x];
+                size_t vertices_list[12];
+
+                for(size_t e=0; e<12; e++) {
+                    if(edge_table[cubeindex] & (1 << e)) {
+                        const uint8_t* loc = cube_edge_plane_table[e];
+                        vertices_list[e] = (*planes[loc[0]])[((y + loc[2]) * nx + x + loc[1]) * 3 + loc[3]];
+                    }
+                }
+
+                for(size_t t=0; triangle_table[cubeindex][t] != -1; t++) {
+                    this->indices[pos++] = vertices_list[triangle_table[cubeindex][t]];
+                }
+            }
+        }
+    }, Schedule::STATIC);
+}
+
+size_t IsoSurface::vertex_from_tetrahedra(const Tetrahedron &_tet, size_t _p1, size_t _p2) const {
+    return this->get_vertex_index(this->get_edge_id(_tet.get_position_from_vertex(_p1),
+                                                    _tet.get_position_from_vertex(_p2)));
+}
+
+/**
+ * @brief      build the vertex table; every grid edge (among the given
+ *             directions) that is intersected by the isosurface yields
+ *             exactly one vertex
+ *
+ * The vertices are stored per row of grid points (constant y and z) and,
+ * within a row, sorted by edge id. A vertex is thus found by a short search
+ * within a single row rather than by matching its coordinates.
+ *
+ * @param[in]  _isovalue    The isovalue
+ * @param[in]  _directions  encoded edge directions to consider
+ */
+void IsoSurface::construct_vertices(float _isovalue, const std::vector<uint8_t>& _directions) {
+    const int64_t nx = this->grid_dimensions[0];
+    const int64_t ny = this->grid_dimensions[1];
+    const int64_t nz = this->grid_dimensions[2];
+    const size_t nrdirs = _directions.size();
+
+    // decode the directions into grid offsets
+    std::vector<int64_t> offsets(nrdirs * 3);
+    for(size_t d=0; d<nrdirs; d++) {
+        offsets[d*3]   = (int64_t)(_directions[d] % 3) - 1;
+        offsets[d*3+1] = (int64_t)((_directions[d] / 3) % 3) - 1;
+        offsets[d*3+2] = (int64_t)(_directions[d] / 9) - 1;
+    }
+
+    // bricks can only be skipped when every edge points away from the
+    // origin, as the edge then lies within the brick of its first point
+    bool use_bricks = true;
+    for(size_t d=0; d<nrdirs * 3; d++) {
+        use_bricks &= (offsets[d] >= 0);
+    }
+
+    // count the number of intersected edges for every row of grid points
+    this->row_offsets.assign(ny * nz + 1, 0);
+    parallel_for(0, nz, [&](size_t _z) {
+        const int64_t z = _z;
+        std::vector<std::pair<size_t, size_t>> ranges(1, {0, nx});
+        for(int64_t y=0; y<ny; y++) {
+            if(use_bricks) {
+                this->vp_ptr->get_active_ranges(y, z, _isovalue, 0, nx, ranges);
+            }
+            size_t count = 0;
+            for(const auto& range : ranges) {
+                for(int64_t x=range.first; x<(int64_t)range.second; x++) {
+                    const bool below = this->vp_ptr->get_value(x, y, z) < _isovalue;
+                    for(size_t d=0; d<nrdirs; d++) {
+                        const int64_t x2 = x + offsets[d*3];
+                        const int64_t y2 = y + offsets[d*3+1];
+                        const int64_t z2 = z + offsets[d*3+2];
+                        if(x2 < 0 || x2 >= nx || y2 < 0 || y2 >= ny || z2 >= nz) {
+                            continue;
+                        }
+                        if((this->vp_ptr->get_value(x2, y2, z2) < _isovalue) != below) {
+                            count++;
+                        }
+                    }
+                }
+            }
+            this->row_offsets[z * ny + y + 1] = count;
+        }
+    }, Schedule::DYNAMIC);
+
+    // convert the counts into the position of the first vertex of each row
+    for(size_t r=1; r<this->row_offsets.size(); r++) {
+        this->row_offsets[r] += this->row_offsets[r-1];
+    }
+
+    // store the edge ids and calculate the vertex positions
+    this->edge_ids.resize(this->row_offsets.back());
+    this->vertices.resize(this->row_offsets.back());
+    this->normals.resize(this->compute_normals ? this->row_offsets.back() : 0);
+    parallel_for(0, nz, [&](size_t _z) {
+        const int64_t z = _z;
+        std::vector<std::pair<size_t, size_t>> ranges(1, {0, nx});
+        for(int64_t y=0; y<ny; y++) {
+            size_t pos = this->row_offsets[z * ny + y];
+            if(pos == this->row_offsets[z * ny + y + 1]) {
+                continue;
+            }
+            if(use_bricks) {
+                this->vp_ptr->get_active_ranges(y, z, _isovalue, 0, nx, ranges);
+            }
+            for(const auto& range : ranges) {
+                for(int64_t x=range.first; x<(int64_t)range.second; x++) {
+                    const bool below = this->vp_ptr->get_value(x, y, z) < _isovalue;
+                    const uint64_t idx = (z * ny + y) * nx + x;
+                    for(size_t d=0; d<nrdirs; d++) {
+                        const int64_t x2 = x + offsets[d*3];
+                        const int64_t y2 = y + offsets[d*3+1];
+                        const int64_t z2 = z + offsets[d*3+2];
+                        if(x2 < 0 || x2 >= nx || y2 < 0 || y2 >= ny || z2 >= nz) {
+                            continue;
+                        }
+                        if((this->vp_ptr->get_value(x2, y2, z2) < _isovalue) != below) {
+                            this->edge_ids[pos] = idx * EDGE_DIRECTIONS + _directions[d];
+                            this->store_vertex(pos, this->edge_ids[pos], _isovalue);
+                            pos++;
+                        }
+                    }
+                }
+            }
+        }
+    }, Schedule::DYNAMIC);
+}
+
+/**
+ * @brief      get the unique id of the grid edge between two
+ *             neighbouring grid points
+ *
+ * The edge is stored at the grid point with the lowest linear index,
+ * together with the direction towards the other grid point.
+ */
+uint64_t IsoSurface::get_edge_id(const Vec3& _p1, const Vec3& _p2) const {
+    const uint64_t nx = this->grid_dimensions[0];
+    const uint64_t ny = this->grid_dimensions[1];
+
+    int64_t x1 = _p1.x, y1 = _p1.y, z1 = _p1.z;
+    int64_t x2 = _p2.x, y2 = _p2.y, z2 = _p2.z;
+    uint64_t idx1 = (z1 * ny + y1) * nx + x1;
+    uint64_t idx2 = (z2 * ny + y2) * nx + x2;
+
+    if(idx2 < idx1) {
+        std::swap(idx1, idx2);
+        std::swap(x1, x2);
+        std::swap(y1, y2);
+        std::swap(z1, z2);
+    }
+
+    return idx1 * EDGE_DIRECTIONS + (x2 - x1 + 1) + 3 * (y2 - y1 + 1) + 9 * (z2 - z1 + 1);
+}
+
+/**
+ * @brief      get the index of the vertex lying on a grid edge
+ *
+ * @param[in]  _edge_id  The edge identifier
+ *
+ * @return     index in the vertex table
+ */
+size_t IsoSurface::get_vertex_index(uint64_t _edge_id) const {
+    const size_t row = (_edge_id / EDGE_DIRECTIONS) / this->grid_dimensions[0];
+    const auto first = this->edge_ids.begin() + this->row_offsets[row];
+    const auto last = this->edge_ids.begin() + this->row_offsets[row+1];
+
+    return std::lower_bound(first, last, _edge_id) - this->edge_ids.begin();
+}
+
+/**
+ * @brief      calculate the vertex where the isosurface intersects a grid
+ *             edge and store it in the vertex table
+ *
+ * @param[in]  _pos       index in the vertex table
+ * @param[in]  _edge_id   The edge identifier
+ * @param[in]  _isovalue  The isovalue
+ */
+void IsoSurface::store_vertex(size_t _pos, uint64_t _edge_id, float _isovalue) {
+    this->interpolate_vertex(_edge_id, _isovalue, &this->vertices[_pos],
+                             this->compute_normals ? &this->normals[_pos] : nullptr);
+}
+
+/**
+ * @brief      calculate the vertex (in real space) where the isosurface
+ *             intersects a grid edge and, optionally, its normal
+ *
+ * The normal is obtained by interpolating the central-difference gradients
+ * at both grid points of the edge with the same factor as the position of
+ * the vertex.
+ *
+ * @param[in]  _edge_id   The edge identifier
+ * @param[in]  _isovalue  The isovalue
+ * @param      _vertex    the vertex
+ * @param      _normal    the normal (not calculated when nullptr)
+ */
+void IsoSurface::interpolate_vertex(uint64_t _edge_id, float _isovalue, Vec3* _vertex, Vec3* _normal) const {
+    const size_t nx = this->grid_dimensions[0];
+    const size_t ny = this->grid_dimensions[1];
+    const uint64_t idx = _edge_id / EDGE_DIRECTIONS;
+    const uint64_t dir = _edge_id % EDGE_DIRECTIONS;
+
+    const size_t x1 = idx % nx;
+    const size_t y1 = (idx / nx) % ny;
+    const size_t z1 = idx / (nx * ny);
+    const size_t x2 = x1 + dir % 3 - 1;
+    const size_t y2 = y1 + (dir / 3) % 3 - 1;
+    const size_t z2 = z1 + dir / 9 - 1;
+
+    float v1 = this->vp_ptr->get_value(x1, y1, z1);
+    float v2 = this->vp_ptr->get_value(x2, y2, z2);
+
+    Vec3 p1((float)x1, (float)y1, (float)z1);
+    Vec3 p2((float)x2, (float)y2, (float)z2);
+
+    float mu = 0.0f;
+    if(std::abs(_isovalue-v1) < PRECISION_LIMIT) {
+        mu = 0.0f;
+    } else if(std::abs(_isovalue-v2) < PRECISION_LIMIT) {
+        mu = 1.0f;
+    } else if(std::abs(v1-v2) >= PRECISION_LIMIT) {
+        mu = (_isovalue - v1) / (v2 - v1);
+    }
+
+    const Vec3 p = p1 + mu * (p2 - p1);
+    *_vertex = this->vp_ptr->grid_to_realspace(p.x, p.y, p.z);
+
+    if(_normal != nullptr) {
+        const Vec3 g1 = this->vp_ptr->get_gradient(x1, y1, z1);
+        const Vec3 g2 = this->vp_ptr->get_gradient(x2, y2, z2);
+        Vec3 gradient = this->vp_ptr->gradient_to_realspace(g1 + mu * (g2 - g1));
+
+        // the central differences vanish when the field oscillates at the
+        // scale of the grid; fall back to the derivative along the edge,
+        // which is non-zero as the edge is intersected
+        if(gradient.dot(gradient) == 0.0f) {
+            gradient = this->vp_ptr->gradient_to_realspace((p2 - p1) * (v2 - v1));
+        }
+
+        // the negative of the gradient is the correct normal (for positive isovalues)
+        *_normal = gradient.normalized() * (_isovalue < 0.0f ? 1.0f : -1.0f);
+    }
+}
+
+/**
+ * @brief      hand the vertices and normals over to a mesh by exchanging
+ *             them with the buffers of the mesh
+ *
+ * @param      _vertices  buffer receiving the vertices
+ * @param      _normals   buffer receiving the normals
+ */
+void IsoSurface::swap_vertices(std::vector<Vec3>& _vertices, std::vector<Vec3>& _normals) {
+    _vertices.clear();
+    _normals.clear();
+    this->vertices.swap(_vertices);
+
+    // without normals, the mesh keeps its own buffer to interpolate them in
+    if(this->compute_normals) {
+        this->normals.swap(_normals);
+    }
+}
+
+/**
+ * @brief      release the vertices, normals and triangle indices and the
+ *             scratch space of the algorithms
+ */
+void IsoSurface::release_buffers() {
+    this->release_buffer(this->cube_table);
+    this->release_buffer(this->slab_cube_offsets);
+    this->release_buffer(this->slab_triangle_offsets);
+    this->release_buffer(this->edge_ids);
+    this->release_buffer(this->row_offsets);
+    this->release_buffer(this->vertices);
+    this->release_buffer(this->normals);
+    this->release_buffer(this->indices);
+    this->release_buffer(this->plane_edges[0]);
+    this->release_buffer(this->plane_edges[1]);
+    this->release_buffer(this->stream_cubeindices);
+    this->release_buffer(this->stream_active);
+    this->release_buffer(this->stream_offsets);
+    this->release_buffer(this->point_cases);
+    this->release_buffer(this->edge_rows);
+    this->release_geometries(this->brick_geometries);
+}
+
+/**
+ * @brief      record the counters of the extraction; to be called before
+ *             the scratch space is released
+ *
+ * The number of bytes allocated covers all buffers held by the isosurface,
+ * including the scratch space of the algorithms.
+ *
+ * @param[in]  _active_cells    number of cells intersected by the
+ *                              isosurface
+ * @param[in]  _vertex_lookups  number of searches in the vertex table
+ */
+void IsoSurface::record_counters(uint64_t _active_cells, uint64_t _vertex_lookups) {
+    uint64_t nrbytes = get_buffer_bytes(this->cube_table) +
+                       get_buffer_bytes(this->slab_cube_offsets) +
+                       get_buffer_bytes(this->slab_triangle_offsets) +
+                       get_buffer_bytes(this->edge_ids) +
+                       get_buffer_bytes(this->row_offsets) +
+                       get_buffer_bytes(this->vertices) +
+                       get_buffer_bytes(this->normals) +
+                       get_buffer_bytes(this->indices) +
+                       get_buffer_bytes(this->plane_edges[0]) +
+                       get_buffer_bytes(this->plane_edges[1]) +
+                       get_buffer_bytes(this->stream_cubeindices) +
+                       get_buffer_bytes(this->stream_active) +
+                       get_buffer_bytes(this->stream_offsets) +
+                       get_buffer_bytes(this->point_cases) +
+                       get_buffer_bytes(this->edge_rows) +
+                       get_buffer_bytes(this->brick_geometries);
+    for(const BrickGeometry& geometry : this->brick_geometries) {
+        nrbytes += get_buffer_bytes(geometry.owned_edges) +
+                   get_buffer_bytes(geometry.foreign_edges) +
+                   get_buffer_bytes(geometry.vertices) +
+                   get_buffer_bytes(geometry.normals) +
+                   get_buffer_bytes(geometry.triangles);
+    }
+
+    this->stats.add_counter("active_cells", _active_cells);
+    this->stats.add_counter("triangles", this->indices.size() / 3);
+    this->stats.add_counter("unique_vertices", this->vertices.size());
+    this->stats.add_counter("vertex_lookups", _vertex_lookups);
+    this->stats.add_counter("bytes_allocated", nrbytes);
+}
+
+/**
+ * @brief      get the position (along x, y and z) of the brick owning
+ *             the first grid point of an edge
+ *
+ * The grid points on the upper faces of a brick belong to the next brick,
+ * except at the upper faces of the grid, where they belong to the last
+ * brick.
+ *
+ * @param[in]  _edge_id  The edge identifier
+ * @param      _brick    position of the brick
+ */
+void IsoSurface::get_owning_brick(uint64_t _edge_id, size_t _brick[3]) const {
+    const size_t nx = this->grid_dimensions[0];
+    const size_t ny = this->grid_dimensions[1];
+    const uint64_t idx = _edge_id / EDGE_DIRECTIONS;
+    const size_t p[3] = {idx % nx, (idx / nx) % ny, idx / (nx * ny)};
+
+    for(unsigned int d=0; d<3; d++) {
+        const size_t lastbrick = (this->grid_dimensions[d] - 2) / TRAVERSAL_BRICK_SIZE;
+        _brick[d] = std::min(p[d] / TRAVERSAL_BRICK_SIZE, lastbrick);
+    }
+}
+
+/**
+ * @brief      classify the cubes of a brick and build its vertices,
+ *             normals and triangles in a single pass
+ *
+ * Every intersected edge receives a slot the first time it is encountered;
+ * the slots are kept in a table indexed by the position of the first grid
+ * point of the edge within the brick and the axis of the edge. The table is
+ * kept per thread and only the used entries are reset afterwards. The
+ * vertices of the edges owned by this brick are calculated right away,
+ * whereas edges owned by a neighbouring brick are resolved when the bricks
+ * are stitched together.
+ *
+ * @param[in]  _brick     The brick
+ * @param[in]  _isovalue  The isovalue
+ * @param      _geometry  local geometry of the brick
+ */
+void IsoSurface::extract_brick(const CubeBrick& _brick, float _isovalue, BrickGeometry& _geometry) const {
+    static constexpr uint32_t UNASSIGNED = 0xFFFFFFFF;
+    static constexpr size_t S = TRAVERSAL_BRICK_SIZE + 1;
+
+    const uint64_t nx = this->grid_dimensions[0];
+    const uint64_t planesize = nx * this->grid_dimensions[1];
+    const size_t nrcubes = nx - 1;
+
+    uint64_t edge_offsets[12];
+    uint8_t edge_directions[12];
+    get_cube_edge_offsets(nx, planesize, edge_offsets, edge_directions);
+    uint32_t key_offsets[12];
+    for(size_t e=0; e<12; e++) {
+        const uint8_t* loc = cube_edge_plane_table[e];
+        key_offsets[e] = ((loc[0] * S + loc[2]) * S + loc[1]) * 3 + loc[3];
+    }
+
+    static thread_local std::vector<uint32_t> edge_slots;
+    if(edge_slots.empty()) {
+        edge_slots.assign(S * S * S * 3, UNASSIGNED);
+    }
+
+    // the geometry may hold the (retained) result of a previous extraction
+    _geometry.foreign_edges.clear();
+    _geometry.triangles.clear();
+    _geometry.nr_active_cubes = 0;
+
+    // classify the cubes, collect the intersected edges and build the
+    // triangles referring to the position of the edges in the list
+    std::vector<uint8_t> cubeindices(nrcubes);
+    std::vector<uint64_t> active((nrcubes + 63) / 64);
+    std::vector<std::pair<size_t, size_t>> ranges;
+    std::vector<float> rowbuffer;
+    std::vector<uint64_t> edges;
+    std::vector<uint32_t> keys;
+    for(size_t i = _brick.begin[2]; i < _brick.end[2]; i++) {
+        for(size_t j = _brick.begin[1]; j < _brick.end[1]; j++) {
+            const size_t nrcubes = this->classify_cubes(j, i, _isovalue, _brick.begin[0], _brick.end[0],
+                                                        cubeindices.data(), active.data(), ranges, rowbuffer);
+            if(nrcubes == 0) {
+                continue;
+            }
+            _geometry.nr_active_cubes += nrcubes;
+            for(size_t w = _brick.begin[0] / 64; w <= (_brick.end[0] - 1) / 64; w++) {
+                for(uint64_t bits = active[w]; bits; bits &= bits - 1) {
+                    const size_t x = w * 64 + ctz64(bits);
+                    const uint64_t idx = i * planesize + j * nx + x;
+                    const uint32_t key = (((i - _brick.begin[2]) * S + (j - _brick.begin[1])) * S +
+                                          (x - _brick.begin[0])) * 3;
+                    const uint8_t cubeindex = cubeindices[x];
+                    uint32_t vertices_list[12];
+                    for(size_t e=0; e<12; e++) {
+                        if(edge_table[cubeindex] & (1 << e)) {
+                            uint32_t& slot = edge_slots[key + key_offsets[e]];
+                            if(slot == UNASSIGNED) {
+                                slot = edges.size();
+                                edges.push_back((idx + edge_offsets[e]) * EDGE_DIRECTIONS + edge_directions[e]);
+                                keys.push_back(key + key_offsets[e]);
+                            }
+                            vertices_list[e] = slot;
+                        }
+                    }
+                    for(size_t t=0; triangle_table[cubeindex][t] != -1; t++) {
+                        _geometry.triangles.push_back(vertices_list[triangle_table[cubeindex][t]]);
+                    }
+                }
+            }
+        }
+    }
+
+    for(uint32_t key : keys) {
+        edge_slots[key] = UNASSIGNED;
+    }
+
+    if(edges.empty()) {
+        _geometry.owned_edges.clear();
+        _geometry.vertices.clear();
+        _geometry.normals.clear();
+        return;
+    }
+
+    // an edge is owned by this brick unless its first grid point lies on an
+    // upper face of the brick which is shared with a neighbouring brick
+    size_t extent[3];
+    for(unsigned int d=0; d<3; d++) {
+        extent[d] = (_brick.end[d] == this->grid_dimensions[d] - 1) ? S : _brick.end[d] - _brick.begin[d];
+    }
+    std::vector<uint32_t> owned;
+    std::vector<uint32_t> slots(edges.size());
+    for(size_t k=0; k<edges.size(); k++) {
+        const uint32_t p = keys[k] / 3;
+        if(p % S < extent[0] && (p / S) % S < extent[1] && p / (S * S) < extent[2]) {
+            owned.push_back(k);
+        } else {
+            slots[k] = _geometry.foreign_edges.size();
+            _geometry.foreign_edges.push_back(edges[k]);
+        }
+    }
+
+    // the owned edges are sorted by edge id, such that neighbouring bricks
+    // can look up the vertices on their shared faces
+    std::sort(owned.begin(), owned.end(), [&edges](uint32_t a, uint32_t b) {
+        return edges[a] < edges[b];
+    });
+    const size_t nrowned = owned.size();
+    _geometry.owned_edges.resize(nrowned);
+    _geometry.vertices.resize(nrowned);
+    _geometry.normals.resize(this->compute_normals ? nrowned : 0);
+    for(size_t k=0; k<nrowned; k++) {
+        _geometry.owned_edges[k] = edges[owned[k]];
+        this->interpolate_vertex(edges[owned[k]], _isovalue, &_geometry.vertices[k],
+                                 this->compute_normals ? &_geometry.normals[k] : nullptr);
+    }
+
+    // translate the position of the edges into slots; foreign edges follow
+    // after the owned edges
+    for(size_t k=0; k<edges.size(); k++) {
+        slots[k] += nrowned;
+    }
+    for(size_t k=0; k<nrowned; k++) {
+        slots[owned[k]] = k;
+    }
+    for(uint32_t& t : _geometry.triangles) {
+        t = slots[t];
+    }
+}
+
+/**
+ * @brief      merge the local geometry of all bricks into the vertex,
+ *             normal and index buffers
+ *
+ * An exclusive scan over the bricks yields the position of the vertices and
+ * triangles of every brick in the output buffers. Every brick then copies
+ * its vertices and translates the slots of its triangles into vertex
+ * indices; slots referring to an edge of a neighbouring brick are looked up
+ * in the (sorted) owned edges of that brick.
+ *
+ * @param[in]  _bricks      the bricks
+ * @param      _geometries  local geometry per brick; released after
+ *                          merging unless the scratch space is retained
+ */
+void IsoSurface::stitch_bricks(const std::vector<CubeBrick>& _bricks, std::vector<BrickGeometry>& _geometries) {
+    const size_t nbricks = _bricks.size();
+    size_t nrbricks[3];
+    for(unsigned int d=0; d<3; d++) {
+        nrbricks[d] = (this->grid_dimensions[d] - 2) / TRAVERSAL_BRICK_SIZE + 1;
+    }
+
+    // position of every brick in the Morton ordered list
+    std::vector<size_t> brick_lookup(nbricks);
+    for(size_t b = 0; b < nbricks; b++) {
+        const size_t bx = _bricks[b].begin[0] / TRAVERSAL_BRICK_SIZE;
+        const size_t by = _bricks[b].begin[1] / TRAVERSAL_BRICK_SIZE;
+        const size_t bz = _bricks[b].begin[2] / TRAVERSAL_BRICK_SIZE;
+        brick_lookup[(bz * nrbricks[1] + by) * nrbricks[0] + bx] = b;
+    }
+
+    // exclusive scan over the bricks
+    std::vector<size_t> vertex_offsets(nbricks + 1, 0);
+    std::vector<size_t> index_offsets(nbricks + 1, 0);
+    for(size_t b = 0; b < nbricks; b++) {
+        vertex_offsets[b+1] = vertex_offsets[b] + _geometries[b].vertices.size();
+        index_offsets[b+1] = index_offsets[b] + _geometries[b].triangles.size();
+    }
+
+    this->vertices.resize(vertex_offsets[nbricks]);
+    this->normals.resize(this->compute_normals ? vertex_offsets[nbricks] : 0);
+    this->indices.resize(index_offsets[nbricks]);
+
+    // only the edges shared with neighbouring bricks are searched for
+    uint64_t nractive = 0;
+    uint64_t nrlookups = 0;
+    for(const BrickGeometry& geometry : _geometries) {
+        nractive += geometry.nr_active_cubes;
+        nrlookups += geometry.foreign_edges.size();
+    }
+
+    parallel_for(0, nbricks, [&](size_t b) {
+        const BrickGeometry& geometry = _geometries[b];
+        std::copy(geometry.vertices.begin(), geometry.vertices.end(),
+                  this->vertices.begin() + vertex_offsets[b]);
+        std::copy(geometry.normals.begin(), geometry.normals.end(),
+                  this->normals.begin() + vertex_offsets[b]);
+
+        // vertex index of every slot
+        const size_t nrowned = geometry.owned_edges.size();
+        std::vector<size_t> vertex_indices(nrowned + geometry.foreign_edges.size());
+        for(size_t k=0; k<nrowned; k++) {
+            vertex_indices[k] = vertex_offsets[b] + k;
+        }
+        for(size_t k=0; k<geometry.foreign_edges.size(); k++) {
+            size_t owner[3];
+            this->get_owning_brick(geometry.foreign_edges[k], owner);
+            const size_t ob = brick_lookup[(owner[2] * nrbricks[1] + owner[1]) * nrbricks[0] + owner[0]];
+            const std::vector<uint64_t>& edges = _geometries[ob].owned_edges;
+            vertex_indices[nrowned + k] = vertex_offsets[ob] +
+                (std::lower_bound(edges.begin(), edges.end(), geometry.foreign_edges[k]) - edges.begin());
+        }
+
+        size_t pos = index_offsets[b];
+        for(uint32_t slot : geometry.triangles) {
+            this->indices[pos++] = vertex_indices[slot];
+        }
+    }, Schedule::DYNAMIC);
+
+    this->record_counters(nractive, nrlookups);
+    this->release_geometries(_geometries);
+}
+
+/**
+ * @brief      release the memory of the local geometry of the bricks;
+ *             when the scratch space is retained, the geometries are
+ *             kept and only emptied such that their buffers are reused
+ *             by the next extraction
+ *
+ * @param      _geometries  local geometry per brick
+ */
+void IsoSurface::release_geometries(std::vector<BrickGeometry>& _geometries) const {
+    if(!this->keep_buffers) {
+        std::vector<BrickGeometry>().swap(_geometries);
+        return;
+    }
+
+    for(BrickGeometry& geometry : _geometries) {
+        geometry.owned_edges.clear();
+        geometry.foreign_edges.clear();
+        geometry.vertices.clear();
+        geometry.normals.clear();
+        geometry.triangles.clear();
+        geometry.nr_active_cubes = 0;
+    }
 }
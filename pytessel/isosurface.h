@@ -23,15 +23,27 @@
 #include <vector>
 #include <iostream>
 #include <cmath>
-#include <mutex>
 #include <memory>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 
 #include "edgetable.h"
 #include "triangletable.h"
 #include "scalar_field.h"
+#include "cell_classifier.h"
+#include "brick_traversal.h"
+#include "extraction_stats.h"
 
 #define PRECISION_LIMIT 0.000000001
 
+/*
+ * Number of possible directions of a grid edge; an edge connects a grid
+ * point with one of its 26 neighbours and the direction is encoded as
+ * (dx+1) + 3*(dy+1) + 9*(dz+1)
+ */
+#define EDGE_DIRECTIONS 27
+
 /*
  *            z
  *            |
@@ -46,23 +58,27 @@
  *
  */
 
-class Cube{
+/**
+ * @brief      compact record of a cube intersected by the isosurface: the
+ *             linear index of its first grid point (vertex 0) and its cube
+ *             index, packed into a single 64 bit integer
+ */
+class ActiveCube{
 private:
-    size_t i,j,k;                           // starting position of the cube
-    float values[8];                              // vector holding cube values
-    size_t cubidx;                          // cubeindex (whether there is an intersection)
+    uint64_t data;
 
 public:
-    Cube();
+    ActiveCube() : data(0) {}
 
-    Cube(size_t _i, size_t _j, size_t _k, const ScalarField &_vp);
+    ActiveCube(uint64_t _idx, uint8_t _cubidx) : data((_idx << 8) | _cubidx) {}
 
-    void set_cube_index(float _isovalue);
-
-    size_t get_cube_index() const;
+    inline uint64_t get_grid_index() const {
+        return this->data >> 8;
+    }
 
-    float get_value_from_vertex(size_t _p) const;
-    Vec3 get_position_from_vertex(size_t _p) const;
+    inline uint8_t get_cube_index() const {
+        return this->data & 0xFF;
+    }
 };
 
 /*
@@ -102,21 +118,34 @@ public:
     const Vec3& get_position_from_vertex(size_t _p) const;
 };
 
-class Triangle{
-public:
-    Vec3 p1, p2, p3;
-
-    Triangle();
-
-    Triangle(const Vec3 &_p1, const Vec3 &_p2, const Vec3 &_p3);
-
-    void transform_to_real(const ScalarField &_vp);
-
-    float get_x(size_t i) const;
-
-    float get_y(size_t i) const;
+/**
+ * @brief      algorithms to construct an isosurface (see IsoSurface::extract)
+ */
+enum class ExtractionMethod {
+    CUBES,
+    STREAMING,
+    BRICKS,
+    FLYING_EDGES,
+    TETRAHEDRA
+};
 
-    float get_z(size_t i) const;
+/**
+ * @brief      geometry extracted from a single brick of cubes
+ *
+ * Every intersected grid edge is owned by the brick holding its first grid
+ * point (grid points on the upper faces of the grid belong to the last
+ * brick); only the owning brick calculates the vertex. Triangles refer to a
+ * slot per edge: slots [0, owned_edges.size()) are the vertices of the brick
+ * itself, the remaining slots refer to foreign_edges, which are owned by one
+ * of the neighbouring bricks.
+ */
+struct BrickGeometry {
+    std::vector<uint64_t> owned_edges;      // sorted ids of the owned edges
+    std::vector<uint64_t> foreign_edges;    // sorted ids of edges owned by neighbours
+    std::vector<Vec3> vertices;             // vertex per owned edge
+    std::vector<Vec3> normals;              // normal per owned edge (optional)
+    std::vector<uint32_t> triangles;        // slot per triangle corner
+    size_t nr_active_cubes = 0;             // number of active cubes
 };
 
 /**
@@ -126,12 +155,27 @@ public:
  */
 class IsoSurface {
 private:
-    std::vector<Cube> cube_table;
-    std::vector<Tetrahedron> tetrahedra_table;
-    std::vector<Triangle> triangles;
+    std::vector<ActiveCube> cube_table;
+    std::vector<size_t> slab_cube_offsets;      // first active cube per slab
+    std::vector<size_t> slab_triangle_offsets;  // first triangle per slab
+    std::vector<uint64_t> edge_ids;             // grid edge ids of the vertices
+    std::vector<size_t> row_offsets;            // first vertex per grid row
+    std::vector<Vec3> vertices;                 // intersection vertices
+    std::vector<Vec3> normals;                  // normals at the vertices (optional)
+    std::vector<size_t> indices;                // triangle indices
+    std::vector<size_t> plane_edges[2];         // streaming: vertex per edge of two planes
+    std::vector<uint8_t> stream_cubeindices;    // streaming: cube indices of a slab
+    std::vector<uint64_t> stream_active;        // streaming: active cubes of a slab
+    std::vector<size_t> stream_offsets;         // streaming: first vertex/triangle per row
+    std::vector<uint8_t> point_cases;           // flying edges: grid point below isovalue
+    std::vector<size_t> edge_rows;              // flying edges: bookkeeping per grid row
+    std::vector<BrickGeometry> brick_geometries;    // bricks: local geometry per brick
     std::shared_ptr<ScalarField> vp_ptr;        // pointer to ScalarField obj
     size_t grid_dimensions[3];
     float isovalue;                             // isovalue setting
+    bool compute_normals;                       // whether to calculate the normals
+    bool keep_buffers;                          // whether to retain the scratch space
+    ExtractionStats stats;                      // timings and counters of the last extraction
 
 public:
     /**
@@ -141,6 +185,14 @@ public:
      */
     IsoSurface(const std::shared_ptr<ScalarField>& _sf);
 
+    /**
+     * @brief      generate isosurface using the specified algorithm
+     *
+     * @param[in]  _isovalue  The isovalue
+     * @param[in]  _method    The algorithm
+     */
+    void extract(float _isovalue, ExtractionMethod _method);
+
     /**
      * @brief      generate isosurface using marching cubes algorithm
      *
@@ -148,6 +200,59 @@ public:
      */
     void marching_cubes(float _isovalue);
 
+    /**
+     * @brief      generate isosurface using marching cubes algorithm while
+     *             traversing the grid in bricks ordered along a Z-order
+     *             curve; every brick is processed as a single task which
+     *             builds the complete local geometry of the brick, after
+     *             which the bricks are stitched together
+     *
+     * @param[in]  _isovalue  The isovalue
+     */
+    void marching_cubes_bricked(float _isovalue);
+
+    /**
+     * @brief      generate isosurface using marching cubes algorithm while
+     *             streaming over the z-planes of the grid; only the state of
+     *             two consecutive planes is kept in memory
+     *
+     * @param[in]  _isovalue  The isovalue
+     */
+    void marching_cubes_streaming(float _isovalue);
+
+    /**
+     * @brief      generate isosurface using marching cubes algorithm while
+     *             streaming over tiles of z-planes of the grid, such that
+     *             for memory-mapped grids only the planes of the current
+     *             and the next tile are resident in memory
+     *
+     * @param[in]  _isovalue       The isovalue
+     * @param[in]  _memory_budget  maximum number of bytes of the grid
+     *                             resident at once
+     */
+    void marching_cubes_tiled(float _isovalue, size_t _memory_budget);
+
+    /**
+     * @brief      generate isosurface using the flying edges algorithm
+     *
+     * @param[in]  _isovalue  The isovalue
+     */
+    void flying_edges(float _isovalue);
+
+    /**
+     * @brief      generate the isosurfaces of several isovalues using the
+     *             marching cubes algorithm in a single sweep over the grid
+     *
+     * @param[in]  _sf         pointer to ScalarField object
+     * @param[in]  _isovalues  The isovalues
+     * @param[in]  _compute_normals  whether to calculate the normals
+     *
+     * @return     one isosurface per isovalue
+     */
+    static std::vector<std::shared_ptr<IsoSurface>> marching_cubes_multi(const std::shared_ptr<ScalarField>& _sf,
+                                                                         const std::vector<float>& _isovalues,
+                                                                         bool _compute_normals = false);
+
     /**
      * @brief      generate isosurface using marching tetrahedra algorithm
      *
@@ -156,11 +261,102 @@ public:
     void marching_tetrahedra(float _isovalue);
 
     /**
-     * @brief      Gets the triangles pointer.
+     * @brief      construct the triangles of all cubes between two z-planes
+     *             as a triangle soup, i.e. without building the vertex table;
+     *             the triangles are the same (and in the same order) as those
+     *             of marching_cubes, oriented along the normal per triangle
+     *
+     * The bricks of the scalar field need to be built beforehand (see
+     * ScalarField::build_bricks).
+     *
+     * @param[in]  _z         z-coordinate of the bottom plane
+     * @param[in]  _isovalue  The isovalue
+     * @param      _vertices  three vertices per triangle
+     * @param      _normals   normal per triangle, calculated from the
+     *                        gradient of the grid
+     */
+    void triangulate_slab(size_t _z, float _isovalue, std::vector<Vec3>& _vertices,
+                          std::vector<Vec3>& _normals) const;
+
+    /**
+     * @brief      get the vertices of the isosurface (in real space)
+     *
+     * @return     the vertices
+     */
+    inline const std::vector<Vec3>& get_vertices() const {
+        return this->vertices;
+    }
+
+    /**
+     * @brief      get the normals at the vertices, these are only available
+     *             when requested using set_compute_normals
+     *
+     * @return     the normals
+     */
+    inline const std::vector<Vec3>& get_normals() const {
+        return this->normals;
+    }
+
+    /**
+     * @brief      whether to calculate the normals at the vertices from the
+     *             gradient of the scalar field on the grid while extracting
+     *             the isosurface
      *
-     * @return     The triangles pointer.
+     * @param[in]  _compute_normals  whether to calculate the normals
      */
-    const std::vector<Triangle>* get_triangles_ptr() const;
+    inline void set_compute_normals(bool _compute_normals) {
+        this->compute_normals = _compute_normals;
+    }
+
+    /**
+     * @brief      whether to retain the scratch space of the algorithms after
+     *             extracting the isosurface, such that subsequent extractions
+     *             from the same scalar field can reuse it
+     *
+     * @param[in]  _keep_buffers  whether to retain the scratch space
+     */
+    inline void set_keep_buffers(bool _keep_buffers) {
+        this->keep_buffers = _keep_buffers;
+    }
+
+    /**
+     * @brief      get the triangle indices, three consecutive indices
+     *             define a single triangle
+     *
+     * @return     the indices
+     */
+    inline const std::vector<size_t>& get_indices() const {
+        return this->indices;
+    }
+
+    /**
+     * @brief      hand the vertices and normals over to a mesh by exchanging
+     *             them with the buffers of the mesh, such that these are
+     *             reused by the next extraction
+     *
+     * @param      _vertices  buffer receiving the vertices
+     * @param      _normals   buffer receiving the normals
+     */
+    void swap_vertices(std::vector<Vec3>& _vertices, std::vector<Vec3>& _normals);
+
+    /**
+     * @brief      release the vertices, normals and triangle indices and the
+     *             scratch space of the algorithms once the mesh has been
+     *             constructed, unless the scratch space is retained (see
+     *             set_keep_buffers)
+     */
+    void release_buffers();
+
+    /**
+     * @brief      get the time spent per phase and the counters (active
+     *             cells, triangles, unique vertices, vertex lookups and bytes
+     *             allocated) of the last extraction
+     *
+     * @return     the statistics
+     */
+    inline const ExtractionStats& get_stats() const {
+        return this->stats;
+    }
 
     inline float get_isovalue() const {
         return this->isovalue;
@@ -172,9 +368,160 @@ public:
 
 private:
     void sample_grid_with_cubes(float _isovalue);
-    void sample_grid_with_tetrahedra(float _isovalue);
-    void construct_triangles_from_cubes(float _isovalue);
-    void construct_triangles_from_tetrahedra(float _isovalue);
-    Vec3 interpolate_from_cubes(const Cube &_cub, size_t _p1, size_t _p2, float _isovalue);
-    Vec3 interpolate_from_tetrahedra(const Tetrahedron &_cub, size_t _p1, size_t _p2, float _isovalue);
+    uint64_t sample_grid_with_tetrahedra(float _isovalue);
+    uint64_t construct_triangles_from_cubes();
+    uint64_t construct_triangles_from_tetrahedra(float _isovalue);
+    void begin_streaming(float _isovalue, size_t _max_planes = 0);
+    void stream_slab(size_t _z, bool _classify = true);
+    void end_streaming();
+    void flying_edges_classify(float _isovalue);
+    void flying_edges_count();
+    void flying_edges_vertices(float _isovalue);
+    uint64_t flying_edges_triangles();
+    void flying_edges_trim(size_t _y, size_t _z, size_t& _left, size_t& _right) const;
+    void stream_vertices(size_t _z, float _isovalue, std::vector<size_t>& _plane_edges,
+                         std::vector<size_t>& _row_offsets);
+    uint64_t stream_classify(size_t _z, float _isovalue, std::vector<uint8_t>& _cubeindices,
+                             std::vector<uint64_t>& _active) const;
+    static void stream_classify_levels(const std::vector<std::shared_ptr<IsoSurface>>& _surfaces, size_t _z);
+    void stream_triangles(const std::vector<size_t>& _bottom_edges, const std::vector<size_t>& _top_edges,
+                          const std::vector<uint8_t>& _cubeindices, const std::vector<uint64_t>& _active,
+                          std::vector<size_t>& _row_offsets);
+
+    /**
+     * @brief      classify (a part of) a row of cubes along x, skipping all
+     *             bricks which do not straddle the isovalue
+     *
+     * @param[in]  _j            y index of the row
+     * @param[in]  _i            z index of the row
+     * @param[in]  _isovalue     The isovalue
+     * @param[in]  _begin        first cube of the row to classify
+     * @param[in]  _end          one past the last cube of the row to classify
+     * @param      _cubeindices  cube index for every cube of the row
+     * @param      _active       bitmask of active cubes
+     * @param      _ranges       scratch space for the active ranges
+     * @param      _rowbuffer    scratch space for rows which are not stored
+     *                           in single precision
+     *
+     * @return     number of active cubes
+     */
+    size_t classify_cubes(size_t _j, size_t _i, float _isovalue, size_t _begin, size_t _end,
+                          uint8_t* _cubeindices, uint64_t* _active,
+                          std::vector<std::pair<size_t, size_t>>& _ranges,
+                          std::vector<float>& _rowbuffer) const;
+    size_t triangles_from_tetrahedron(const Tetrahedron &_tet, size_t* _indices) const;
+    size_t vertex_from_tetrahedra(const Tetrahedron &_tet, size_t _p1, size_t _p2) const;
+
+    /**
+     * @brief      build the vertex table; every grid edge (among the given
+     *             directions) that is intersected by the isosurface yields
+     *             exactly one vertex
+     *
+     * @param[in]  _isovalue    The isovalue
+     * @param[in]  _directions  encoded edge directions to consider
+     */
+    void construct_vertices(float _isovalue, const std::vector<uint8_t>& _directions);
+
+    /**
+     * @brief      get the unique id of the grid edge between two
+     *             neighbouring grid points
+     *
+     * The edge is stored at the grid point with the lowest linear index,
+     * together with the direction towards the other grid point.
+     */
+    uint64_t get_edge_id(const Vec3& _p1, const Vec3& _p2) const;
+
+    /**
+     * @brief      get the index of the vertex lying on a grid edge
+     *
+     * @param[in]  _edge_id  The edge identifier
+     *
+     * @return     index in the vertex table
+     */
+    size_t get_vertex_index(uint64_t _edge_id) const;
+
+    /**
+     * @brief      calculate the vertex where the isosurface intersects a grid
+     *             edge and store it (and its normal) in the vertex table
+     *
+     * @param[in]  _pos       index in the vertex table
+     * @param[in]  _edge_id   The edge identifier
+     * @param[in]  _isovalue  The isovalue
+     */
+    void store_vertex(size_t _pos, uint64_t _edge_id, float _isovalue);
+
+    /**
+     * @brief      calculate the vertex (in real space) where the isosurface
+     *             intersects a grid edge and, optionally, its normal
+     *
+     * @param[in]  _edge_id   The edge identifier
+     * @param[in]  _isovalue  The isovalue
+     * @param      _vertex    the vertex
+     * @param      _normal    the normal (not calculated when nullptr)
+     */
+    void interpolate_vertex(uint64_t _edge_id, float _isovalue, Vec3* _vertex, Vec3* _normal) const;
+
+    /**
+     * @brief      classify the cubes of a brick and build its vertices,
+     *             normals and triangles in a single pass
+     *
+     * @param[in]  _brick     The brick
+     * @param[in]  _isovalue  The isovalue
+     * @param      _geometry  local geometry of the brick
+     */
+    void extract_brick(const CubeBrick& _brick, float _isovalue, BrickGeometry& _geometry) const;
+
+    /**
+     * @brief      merge the local geometry of all bricks into the vertex,
+     *             normal and index buffers
+     *
+     * @param[in]  _bricks      the bricks
+     * @param      _geometries  local geometry per brick; released after
+     *                          merging unless the scratch space is retained
+     */
+    void stitch_bricks(const std::vector<CubeBrick>& _bricks, std::vector<BrickGeometry>& _geometries);
+
+    /**
+     * @brief      get the position (along x, y and z) of the brick owning
+     *             the first grid point of an edge
+     *
+     * @param[in]  _edge_id  The edge identifier
+     * @param      _brick    position of the brick
+     */
+    void get_owning_brick(uint64_t _edge_id, size_t _brick[3]) const;
+
+    /**
+     * @brief      record the counters of the extraction; to be called before
+     *             the scratch space is released
+     *
+     * @param[in]  _active_cells    number of cells intersected by the
+     *                              isosurface
+     * @param[in]  _vertex_lookups  number of searches in the vertex table
+     */
+    void record_counters(uint64_t _active_cells, uint64_t _vertex_lookups);
+
+    /**
+     * @brief      release the memory of a scratch buffer, unless the scratch
+     *             space is retained (see set_keep_buffers)
+     *
+     * @param      _buffer  the buffer
+     */
+    template<typename T>
+    void release_buffer(std::vector<T>& _buffer) const {
+        if(this->keep_buffers) {
+            _buffer.clear();
+        } else {
+            std::vector<T>().swap(_buffer);
+        }
+    }
+
+    /**
+     * @brief      release the memory of the local geometry of the bricks;
+     *             when the scratch space is retained, the geometries are
+     *             kept and only emptied such that their buffers are reused
+     *             by the next extraction
+     *
+     * @param      _geometries  local geometry per brick
+     */
+    void release_geometries(std::vector<BrickGeometry>& _geometries) const;
 };
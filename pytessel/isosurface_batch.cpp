@@ -0,0 +1,82 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   PyTessel is free software:                                           *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   PyTessel is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "isosurface_batch.h"
+#include "parallel.h"
+
+/**
+ * @brief      construct the isosurfaces of a batch of (small) scalar fields;
+ *             the fields are distributed over the threads, each field being
+ *             processed serially by a single thread, and the resulting
+ *             meshes are concatenated
+ *
+ * @param[in]  _fields           the scalar fields
+ * @param[in]  _isovalues        isovalue per scalar field
+ * @param[in]  _method           the algorithm
+ * @param[in]  _compute_normals  whether to calculate the normals from the
+ *                               gradient on the grid while extracting the
+ *                               isosurfaces
+ * @param[in]  _cache_gradients  whether to precompute the gradient volumes
+ *                               (released after every extraction)
+ * @param      _vertex_offsets   first vertex of every isosurface (and the
+ *                               total number of vertices)
+ * @param      _index_offsets    first triangle index of every isosurface (and
+ *                               the total number of indices)
+ *
+ * @return     the concatenated (centered) isosurface meshes
+ */
+std::shared_ptr<IsoSurfaceMesh> marching_cubes_batch(const std::vector<std::shared_ptr<ScalarField>>& _fields,
+                                                     const std::vector<float>& _isovalues,
+                                                     ExtractionMethod _method,
+                                                     bool _compute_normals,
+                                                     bool _cache_gradients,
+                                                     std::vector<size_t>& _vertex_offsets,
+                                                     std::vector<size_t>& _index_offsets) {
+    if(_fields.size() != _isovalues.size()) {
+        throw std::invalid_argument("Number of isovalues (" + std::to_string(_isovalues.size()) +
+                                    ") does not match the number of scalar fields (" +
+                                    std::to_string(_fields.size()) + ")");
+    }
+
+    // small fields do not provide enough work to parallelize within a
+    // field, hence every field is a single task executed by one thread
+    std::vector<std::shared_ptr<IsoSurfaceMesh>> meshes(_fields.size());
+    parallel_for(0, _fields.size(), [&](size_t i) {
+        SerialRegion serial;
+
+        if(_cache_gradients) {
+            _fields[i]->build_gradients();
+        }
+
+        auto isosurface = std::make_shared<IsoSurface>(_fields[i]);
+        isosurface->set_compute_normals(_compute_normals);
+        isosurface->extract(_isovalues[i], _method);
+
+        // the gradient volume is only used during the extraction
+        if(_cache_gradients) {
+            _fields[i]->release_gradients();
+        }
+
+        meshes[i] = std::make_shared<IsoSurfaceMesh>(_fields[i], isosurface);
+        meshes[i]->construct_mesh(true);
+    }, Schedule::DYNAMIC);
+
+    return IsoSurfaceMesh::concatenate(meshes, _vertex_offsets, _index_offsets);
+}
@@ -19,6 +19,7 @@
  **************************************************************************/
 
 #include "isosurface_mesh.h"
+#include "parallel.h"
 
 /**
  * @brief      build isosurface mesh object
@@ -27,40 +28,138 @@
  * @param[in]  _is   pointer to isosurface
  */
 IsoSurfaceMesh::IsoSurfaceMesh(const std::shared_ptr<const ScalarField>& _sf,
-                               const std::shared_ptr<const IsoSurface>& _is) :
+                               const std::shared_ptr<IsoSurface>& _is) :
     sf(_sf),
     is(_is) {
 }
 
 /**
- * @brief      construct surface mesh
+ * @brief      concatenate several meshes into a single mesh; the triangle
+ *             indices of every mesh keep referring to its own vertices
+ *
+ * @param[in]  _meshes           the meshes
+ * @param      _vertex_offsets   first vertex of every mesh (and the total
+ *                               number of vertices)
+ * @param      _index_offsets    first triangle index of every mesh (and
+ *                               the total number of indices)
+ *
+ * @return     the concatenated mesh
+ */
+std::shared_ptr<IsoSurfaceMesh> IsoSurfaceMesh::concatenate(const std::vector<std::shared_ptr<IsoSurfaceMesh>>& _meshes,
+                                                            std::vector<size_t>& _vertex_offsets,
+                                                            std::vector<size_t>& _index_offsets) {
+    std::shared_ptr<IsoSurfaceMesh> mesh(new IsoSurfaceMesh());
+
+    // scan the sizes of the meshes; 64 bit indices are only required when
+    // any of the meshes already uses them
+    _vertex_offsets.assign(_meshes.size() + 1, 0);
+    _index_offsets.assign(_meshes.size() + 1, 0);
+    bool wide = false;
+    for(size_t i=0; i<_meshes.size(); i++) {
+        _vertex_offsets[i+1] = _vertex_offsets[i] + _meshes[i]->get_nr_vertices();
+        _index_offsets[i+1] = _index_offsets[i] + _meshes[i]->get_nr_indices();
+        wide |= !_meshes[i]->indices64.empty();
+    }
+
+    mesh->vertices.resize(_vertex_offsets.back());
+    mesh->normals.resize(_vertex_offsets.back());
+    if(wide) {
+        mesh->indices64.resize(_index_offsets.back());
+    } else {
+        mesh->indices32.resize(_index_offsets.back());
+    }
+
+    parallel_for(0, _meshes.size(), [&](size_t i) {
+        const IsoSurfaceMesh& part = *_meshes[i];
+        std::copy(part.vertices.begin(), part.vertices.end(), mesh->vertices.begin() + _vertex_offsets[i]);
+        std::copy(part.normals.begin(), part.normals.end(), mesh->normals.begin() + _vertex_offsets[i]);
+        if(wide) {
+            std::copy(part.indices32.begin(), part.indices32.end(), mesh->indices64.begin() + _index_offsets[i]);
+            std::copy(part.indices64.begin(), part.indices64.end(), mesh->indices64.begin() + _index_offsets[i]);
+        } else {
+            std::copy(part.indices32.begin(), part.indices32.end(), mesh->indices32.begin() + _index_offsets[i]);
+        }
+    }, Schedule::DYNAMIC);
+
+    return mesh;
+}
+
+/**
+ * @brief      construct surface mesh; the vertices and normals are taken
+ *             over from the isosurface, after which the isosurface releases
+ *             its buffers and neither the isosurface nor the scalar field
+ *             are referenced any longer
  *
  * @param[in]  center  whether to center structure
  */
 void IsoSurfaceMesh::construct_mesh(bool center_mesh) {
+    this->stats.clear();
+    PhaseTimer timer(this->stats, "copy_vertices");
+
    // grab center
     this->center = this->sf->get_mat_unitcell() * Vec3(0.5, 0.5, 0.5);
 
-    for(size_t i=0; i<this->is->get_triangles_ptr()->size(); i++) {
-        // load all index vertices in a map; this operation needs to be done, else a SEGFAULT
-        // will be thrown further down the lines
-        this->get_index_vertex(is->get_triangles_ptr()->at(i).p1);
-        this->get_index_vertex(is->get_triangles_ptr()->at(i).p2);
-        this->get_index_vertex(is->get_triangles_ptr()->at(i).p3);
+    // the isosurface already provides shared vertices (one per intersected
+    // grid edge) and the triangle indices referring to them; the vertices
+    // and normals are taken over rather than copied
+    this->is->swap_vertices(this->vertices, this->normals);
+
+    timer.next("normals");
+    const bool interpolate_normals = this->normals.empty();
+    if(interpolate_normals) {
+        this->calculate_normals();
     }
 
-    // build vertex vector from unordered map
-    this->vertices.resize(this->vertices_map.size());
-    for(auto it : this->vertices_map) {
-        this->vertices[it.second] = it.first;
+    // put indices in right orientation based on face normal; the indices
+    // are narrowed to 32 bit whenever the number of vertices allows it
+    timer.next("orient_triangles");
+    const std::vector<size_t>& triangles = this->is->get_indices();
+    this->indices32.clear();
+    this->indices64.clear();
+    if(this->vertices.size() <= (size_t)std::numeric_limits<uint32_t>::max() + 1) {
+        this->orient_triangles(triangles, this->indices32);
+    } else {
+        this->orient_triangles(triangles, this->indices64);
     }
 
+    // the isosurface and the scalar field are no longer required; the
+    // arrays sharing the buffers of the mesh should not keep the grid (or
+    // its acceleration data) alive
+    this->is->release_buffers();
+    this->is.reset();
+    this->sf.reset();
+
+    // center structure
+    if(center_mesh) {
+        timer.next("center");
+        parallel_for(0, this->vertices.size(), [&](size_t i) {
+           this->vertices[i] -= this->center;
+        });
+    }
+    timer.next(nullptr);
+
+    // the vertices and normals taken over from the isosurface have already
+    // been accounted for by the isosurface
+    const uint64_t nrbytes = get_buffer_bytes(this->vertices) +
+                             get_buffer_bytes(this->normals) +
+                             get_buffer_bytes(this->indices32) +
+                             get_buffer_bytes(this->indices64);
+    const uint64_t nrbytes_taken = get_buffer_bytes(this->vertices) +
+                                   (interpolate_normals ? 0 : get_buffer_bytes(this->normals));
+    this->stats.add_counter("bytes_allocated", nrbytes - nrbytes_taken);
+    this->stats.add_counter("bytes_retained", nrbytes);
+}
+
+/**
+ * @brief      calculate the normals at the vertices by sampling the scalar
+ *             field around every vertex
+ */
+void IsoSurfaceMesh::calculate_normals() {
     double dev = 0.01;
     this->normals.resize(this->vertices.size());
 
     // calculate normal vectors
-    #pragma omp parallel for schedule(static)
-    for(size_t i=0; i<this->vertices.size(); i++) {
+    parallel_for(0, this->vertices.size(), [&](size_t i) {
         // get derivatives
         double dx0 = sf->get_value_interp(this->vertices[i].x - dev, this->vertices[i].y, this->vertices[i].z);
         double dx1 = sf->get_value_interp(this->vertices[i].x + dev, this->vertices[i].y, this->vertices[i].z);
@@ -77,14 +176,26 @@ void IsoSurfaceMesh::construct_mesh(bool center_mesh) {
         normal = -1 * normal.normalized(); // the negative of the gradient is the correct normal
 
         this->normals[i] = normal * sgn(sf->get_value_interp(this->vertices[i].x, this->vertices[i].y, this->vertices[i].z));
-    }
+    }, Schedule::STATIC);
+}
 
-    // build indices in right orientation based on face normal
-    for(size_t i=0; i<this->is->get_triangles_ptr()->size(); i++) {
+/**
+ * @brief      copy the triangle indices while putting them in the right
+ *             orientation based on the normals at the vertices
+ *
+ * @param[in]  _indices  triangle indices of the isosurface
+ * @param      _out      oriented triangle indices
+ */
+template<typename T>
+void IsoSurfaceMesh::orient_triangles(const std::vector<size_t>& _indices, std::vector<T>& _out) const {
+    _out.resize(_indices.size());
+
+    parallel_for(0, _indices.size() / 3, [&](size_t t) {
         // calculate face normal
-        size_t id1 = this->get_index_vertex(is->get_triangles_ptr()->at(i).p1);
-        size_t id2 = this->get_index_vertex(is->get_triangles_ptr()->at(i).p2);
-        size_t id3 = this->get_index_vertex(is->get_triangles_ptr()->at(i).p3);
+        const size_t i = t * 3;
+        const size_t id1 = _indices[i];
+        const size_t id2 = _indices[i+1];
+        const size_t id3 = _indices[i+2];
 
         // calculate the orientation of the face with respect to the normal
         const Vec3 face_normal = (this->normals[id1] + this->normals[id2] + this->normals[id3]) / 3.0f;
@@ -93,60 +204,12 @@ void IsoSurfaceMesh::construct_mesh(bool center_mesh) {
 
         // if orientation is positive, the orientation is correct, if it is negative, the orientation is incorrect and two indices should be swapped
         if(orientation > 0.0f) {
-            this->indices.push_back(id1);
-            this->indices.push_back(id2);
-            this->indices.push_back(id3);
+            _out[i] = id1;
+            _out[i+1] = id2;
         } else {
-            this->indices.push_back(id2);
-            this->indices.push_back(id1);
-            this->indices.push_back(id3);
+            _out[i] = id2;
+            _out[i+1] = id1;
         }
-    }
-
-    // center structure
-    if(center_mesh) {
-        Vec3 sum = this->sf->get_mat_unitcell() * Vec3(0.5f, 0.5f, 0.5f);
-
-        #pragma omp parallel for
-        for(size_t i=0; i<this->vertices.size(); i++) {
-           this->vertices[i] -= sum;
-        }
-    }
-}
-
-/**
- * @brief      get the index of a vertex from unordered map
- *
- * @param[in]  v     vertex coordinates
- *
- * @return     the index
- */
-size_t IsoSurfaceMesh::get_index_vertex(const Vec3 v) {
-    auto got = this->vertices_map.find(v);
-    if(got != this->vertices_map.end()) {
-        return got->second;
-    }
-
-    const size_t id = vertices_map.size();
-    vertices_map.emplace(v, id);
-    return id;
-}
-
-std::vector<float> IsoSurfaceMesh::get_vertices() const {
-    std::vector<float> out;
-    out.reserve(vertices.size() * 3);
-    for (const auto& v : vertices) {
-        out.push_back(v.x);
-        out.push_back(v.y);
-        out.push_back(v.z);
-    }
-    return out;
-}
-
-std::vector<float> IsoSurfaceMesh::get_normals() const {
-    return std::vector<float>(&this->normals[0].x, &this->normals[0].x + this->normals.size() * 3);
-}
-
-const std::vector<size_t>& IsoSurfaceMesh::get_indices() const {
-    return this->indices;
+        _out[i+2] = id3;
+    }, Schedule::STATIC);
 }
@@ -23,8 +23,9 @@
 #include <fstream>
 #include <set>
 #include <vector>
-#include <unordered_map>
 #include <memory>
+#include <cstdint>
+#include <limits>
 
 #include "vec3.h"
 #include "isosurface.h"
@@ -34,36 +35,22 @@ template <typename T> float sgn(T val) {
     return (T(0) < val) - (val < T(0));
 }
 
-/**
- * @brief      structure to put Vec3f in a map
- */
-struct KeyFuncs
-{
-    size_t operator()(const Vec3& k)const
-    {
-        return std::hash<float>()(k.x) ^ std::hash<float>()(k.y) ^ std::hash<float>()(k.z);
-    }
-
-    bool operator()(const Vec3& a, const Vec3& b)const
-    {
-            return a.x == b.x && a.y == b.y && a.z == b.z;
-    }
-};
-
 /**
  * @brief      Class for iso surface mesh.
  */
 class IsoSurfaceMesh{
 private:
-    std::unordered_map<Vec3, size_t, KeyFuncs, KeyFuncs> vertices_map;
     std::vector<Vec3> vertices;
     std::vector<Vec3> normals;
-    std::vector<size_t> indices;
+    std::vector<uint32_t> indices32;    // triangle indices (up to 2^32 vertices)
+    std::vector<uint64_t> indices64;    // triangle indices (beyond 2^32 vertices)
+
+    std::shared_ptr<const ScalarField> sf;  // scalar field, released once the mesh is constructed
+    std::shared_ptr<IsoSurface> is;         // isosurface, released once the mesh is constructed
 
-    std::shared_ptr<const ScalarField> sf;
-    std::shared_ptr<const IsoSurface> is;
+    Vec3 center;                            // center of the unitcell
 
-    Vec3 center;
+    ExtractionStats stats;  // timings and counters of the last construction
 
 public:
     /**
@@ -73,32 +60,118 @@ public:
      * @param[in]  _is   pointer to isosurface
      */
     IsoSurfaceMesh(const std::shared_ptr<const ScalarField>& _sf,
-                   const std::shared_ptr<const IsoSurface>& _is);
+                   const std::shared_ptr<IsoSurface>& _is);
 
     IsoSurfaceMesh(const std::vector<float>& vertices,
                    const std::vector<float>& normals,
                    const std::vector<size_t>& indices);
 
     /**
-     * @brief      construct surface mesh
+     * @brief      concatenate several meshes into a single mesh; the triangle
+     *             indices of every mesh keep referring to its own vertices
+     *
+     * @param[in]  _meshes           the meshes
+     * @param      _vertex_offsets   first vertex of every mesh (and the total
+     *                               number of vertices)
+     * @param      _index_offsets    first triangle index of every mesh (and
+     *                               the total number of indices)
+     *
+     * @return     the concatenated mesh
+     */
+    static std::shared_ptr<IsoSurfaceMesh> concatenate(const std::vector<std::shared_ptr<IsoSurfaceMesh>>& _meshes,
+                                                       std::vector<size_t>& _vertex_offsets,
+                                                       std::vector<size_t>& _index_offsets);
+
+    /**
+     * @brief      construct surface mesh; the vertices and normals are taken
+     *             over from the isosurface, after which the isosurface
+     *             releases its buffers and neither the isosurface nor the
+     *             scalar field are referenced any longer
      *
      * @param[in]  center_mesh  whether to center structure
      */
     void construct_mesh(bool center_mesh);
 
-    std::vector<float> get_vertices() const;
+    /**
+     * @brief      set the scalar field and the isosurface from which the mesh
+     *             is (re)constructed, reusing the buffers of the mesh
+     *
+     * @param[in]  _sf   pointer to scalar field
+     * @param[in]  _is   pointer to isosurface
+     */
+    inline void set_isosurface(const std::shared_ptr<const ScalarField>& _sf,
+                               const std::shared_ptr<IsoSurface>& _is) {
+        this->sf = _sf;
+        this->is = _is;
+    }
 
-    std::vector<float> get_normals() const;
+    /**
+     * @brief      get pointer to the vertices, stored as consecutive
+     *             (x,y,z) triplets of floats
+     */
+    inline const float* get_vertices() const {
+        return reinterpret_cast<const float*>(this->vertices.data());
+    }
 
-    const std::vector<size_t>& get_indices() const;
+    /**
+     * @brief      get pointer to the normals, stored as consecutive
+     *             (x,y,z) triplets of floats
+     */
+    inline const float* get_normals() const {
+        return reinterpret_cast<const float*>(this->normals.data());
+    }
+
+    inline size_t get_nr_vertices() const {
+        return this->vertices.size();
+    }
+
+    /**
+     * @brief      get pointer to the triangle indices; these are stored as
+     *             32 bit unsigned integers unless the number of vertices
+     *             requires 64 bit unsigned integers (see get_index_size)
+     */
+    inline const void* get_indices() const {
+        return this->indices64.empty() ? static_cast<const void*>(this->indices32.data()) :
+                                         static_cast<const void*>(this->indices64.data());
+    }
+
+    inline size_t get_nr_indices() const {
+        return this->indices64.empty() ? this->indices32.size() : this->indices64.size();
+    }
+
+    /**
+     * @brief      get the number of bytes of a single triangle index
+     */
+    inline size_t get_index_size() const {
+        return this->indices64.empty() ? sizeof(uint32_t) : sizeof(uint64_t);
+    }
+
+    /**
+     * @brief      get the time spent per phase and the number of bytes
+     *             allocated while constructing the mesh
+     */
+    inline const ExtractionStats& get_stats() const {
+        return this->stats;
+    }
 
 private:
+    IsoSurfaceMesh() = default;
+
     /**
-     * @brief      get the index of a vertex from unordered map
-     *
-     * @param[in]  v     vertex coordinates
+     * @brief      calculate the normals at the vertices by sampling the scalar
+     *             field around every vertex
+     */
+    void calculate_normals();
+
+    /**
+     * @brief      copy the triangle indices while putting them in the right
+     *             orientation based on the normals at the vertices
      *
-     * @return     the index
+     * @param[in]  _indices  triangle indices of the isosurface
+     * @param      _out      oriented triangle indices
      */
-    size_t get_index_vertex(const Vec3 v);
+    template<typename T>
+    void orient_triangles(const std::vector<size_t>& _indices, std::vector<T>& _out) const;
 };
+
+static_assert(sizeof(Vec3) == 3 * sizeof(float), "Vec3 needs to be tightly packed");
@@ -0,0 +1,241 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   PyTessel is free software:                                           *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   PyTessel is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief      map a file into memory
+ *
+ * @param[in]  _filename  path to the file
+ */
+MappedFile::MappedFile(const std::string& _filename) :
+    data(nullptr),
+    size(0) {
+#ifdef _WIN32
+    this->file_handle = CreateFileA(_filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                    FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(this->file_handle == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Cannot open file: " + _filename);
+    }
+    LARGE_INTEGER filesize;
+    if(!GetFileSizeEx(this->file_handle, &filesize) || filesize.QuadPart == 0) {
+        CloseHandle(this->file_handle);
+        throw std::runtime_error("Cannot map empty file: " + _filename);
+    }
+    this->size = static_cast<size_t>(filesize.QuadPart);
+    this->mapping_handle = CreateFileMappingA(this->file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* view = this->mapping_handle ? MapViewOfFile(this->mapping_handle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if(view == nullptr) {
+        if(this->mapping_handle) {
+            CloseHandle(this->mapping_handle);
+        }
+        CloseHandle(this->file_handle);
+        throw std::runtime_error("Cannot map file: " + _filename);
+    }
+    this->data = static_cast<const char*>(view);
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    this->pagesize = info.dwPageSize;
+#else
+    this->fd = open(_filename.c_str(), O_RDONLY);
+    if(this->fd < 0) {
+        throw std::runtime_error("Cannot open file: " + _filename);
+    }
+    struct stat st;
+    if(fstat(this->fd, &st) != 0 || st.st_size == 0) {
+        close(this->fd);
+        throw std::runtime_error("Cannot map empty file: " + _filename);
+    }
+    this->size = static_cast<size_t>(st.st_size);
+    void* view = mmap(nullptr, this->size, PROT_READ, MAP_SHARED, this->fd, 0);
+    if(view == MAP_FAILED) {
+        close(this->fd);
+        throw std::runtime_error("Cannot map file: " + _filename);
+    }
+    this->data = static_cast<const char*>(view);
+    this->pagesize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+    UnmapViewOfFile(this->data);
+    CloseHandle(this->mapping_handle);
+    CloseHandle(this->file_handle);
+#else
+    munmap(const_cast<char*>(this->data), this->size);
+    close(this->fd);
+#endif
+}
+
+/**
+ * @brief      hint that a range of the file is about to be read
+ *
+ * On Windows, the advice is ignored and paging is left to the system.
+ *
+ * @param[in]  _offset  first byte of the range
+ * @param[in]  _length  length of the range in bytes
+ */
+void MappedFile::will_need(size_t _offset, size_t _length) const {
+    if(_offset >= this->size) {
+        return;
+    }
+    const size_t begin = _offset / this->pagesize * this->pagesize;
+    const size_t end = std::min(this->size, _offset + _length);
+    if(begin >= end) {
+        return;
+    }
+#ifndef _WIN32
+    madvise(const_cast<char*>(this->data) + begin, end - begin, MADV_WILLNEED);
+#endif
+}
+
+/**
+ * @brief      hint that a range of the file is no longer needed
+ *
+ * The pages are removed from the address space of the process and, where
+ * supported, from the page cache. On Windows, the advice is ignored and
+ * paging is left to the system.
+ *
+ * @param[in]  _offset  first byte of the range
+ * @param[in]  _length  length of the range in bytes
+ */
+void MappedFile::dont_need(size_t _offset, size_t _length) const {
+    const size_t begin = (_offset + this->pagesize - 1) / this->pagesize * this->pagesize;
+    size_t end = std::min(this->size, _offset + _length);
+    if(end < this->size) {
+        end = end / this->pagesize * this->pagesize;
+    }
+    if(begin >= end) {
+        return;
+    }
+#ifndef _WIN32
+    madvise(const_cast<char*>(this->data) + begin, end - begin, MADV_DONTNEED);
+#ifdef POSIX_FADV_DONTNEED
+    posix_fadvise(this->fd, begin, end - begin, POSIX_FADV_DONTNEED);
+#endif
+#endif
+}
+
+/**
+ * @brief      find the value of a key in the dictionary of a .npy header
+ *
+ * @param[in]  _header  the header
+ * @param[in]  _key     the key (without quotes)
+ *
+ * @return     position of the first character of the value
+ */
+static size_t find_npy_value(const std::string& _header, const std::string& _key) {
+    size_t pos = _header.find("'" + _key + "'");
+    if(pos == std::string::npos) {
+        throw std::runtime_error("Invalid .npy header, missing key: " + _key);
+    }
+    pos = _header.find(':', pos);
+    if(pos == std::string::npos) {
+        throw std::runtime_error("Invalid .npy header: " + _header);
+    }
+    return _header.find_first_not_of(' ', pos + 1);
+}
+
+/**
+ * @brief      parse the header of a mapped NumPy (.npy) file holding a
+ *             three-dimensional array in C order
+ *
+ * @param[in]  _file        the mapped file
+ * @param[out] _dtype       element type as typecode and number of bytes
+ * @param[out] _dimensions  grid dimensions (nx, ny, nz)
+ *
+ * @return     offset of the array data in bytes
+ */
+size_t read_npy_header(const MappedFile& _file, std::string& _dtype, std::vector<size_t>& _dimensions) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(_file.get_data());
+    if(_file.get_size() < 10 || std::memcmp(bytes, "\x93NUMPY", 6) != 0) {
+        throw std::runtime_error("Not a .npy file");
+    }
+
+    // version 1 stores the length of the header in two bytes, later
+    // versions in four bytes (little endian)
+    size_t offset = bytes[6] == 1 ? 10 : 12;
+    size_t headerlen = bytes[8] | (bytes[9] << 8);
+    if(bytes[6] != 1) {
+        headerlen |= (static_cast<size_t>(bytes[10]) << 16) | (static_cast<size_t>(bytes[11]) << 24);
+    }
+    if(offset + headerlen > _file.get_size()) {
+        throw std::runtime_error("Invalid .npy header");
+    }
+    const std::string header(_file.get_data() + offset, headerlen);
+    offset += headerlen;
+
+    // element type, which needs to be stored in the native byte order
+    size_t pos = find_npy_value(header, "descr");
+    const size_t end = header.find_first_of("'\"", pos + 1);
+    if(pos == std::string::npos || end == std::string::npos || end - pos != 4) {
+        throw std::runtime_error("Unsupported data type in .npy header: " + header);
+    }
+    const uint16_t one = 1;
+    const char native = *reinterpret_cast<const char*>(&one) == 1 ? '<' : '>';
+    const char byteorder = header[pos + 1];
+    _dtype = header.substr(pos + 2, 2);
+    if(byteorder != native && byteorder != '|' && byteorder != '=') {
+        throw std::runtime_error("Unsupported byte order in .npy header: " + header);
+    }
+
+    pos = find_npy_value(header, "fortran_order");
+    if(header.compare(pos, 5, "False") != 0) {
+        throw std::runtime_error("Arrays in Fortran order are not supported, store the array in C order");
+    }
+
+    // shape (nz, ny, nx)
+    pos = find_npy_value(header, "shape");
+    std::vector<size_t> shape;
+    if(header[pos] == '(') {
+        pos++;
+        while(true) {
+            pos = header.find_first_not_of(", ", pos);
+            if(pos == std::string::npos || header[pos] == ')') {
+                break;
+            }
+            size_t len = 0;
+            shape.push_back(std::stoull(header.substr(pos), &len));
+            pos += len;
+        }
+    }
+    if(shape.size() != 3) {
+        throw std::runtime_error("Scalar field in .npy file should be a three-dimensional array: " + header);
+    }
+    _dimensions.assign(shape.rbegin(), shape.rend());
+
+    return offset;
+}
@@ -0,0 +1,98 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   PyTessel is free software:                                           *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   PyTessel is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * @brief      read-only memory mapping of a file; pages are loaded on demand
+ *             by the operating system, such that files larger than the
+ *             available memory can be processed as long as only a part of
+ *             them is accessed at a time
+ */
+class MappedFile {
+private:
+    const char* data;       // start of the mapping
+    size_t size;            // size of the file in bytes
+    size_t pagesize;        // granularity of the memory advice
+#ifdef _WIN32
+    void* file_handle;
+    void* mapping_handle;
+#else
+    int fd;
+#endif
+
+public:
+    /**
+     * @brief      map a file into memory
+     *
+     * @param[in]  _filename  path to the file
+     */
+    explicit MappedFile(const std::string& _filename);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    inline const char* get_data() const {
+        return this->data;
+    }
+
+    inline size_t get_size() const {
+        return this->size;
+    }
+
+    /**
+     * @brief      hint that a range of the file is about to be read, such that
+     *             it is read ahead in the background
+     *
+     * @param[in]  _offset  first byte of the range
+     * @param[in]  _length  length of the range in bytes
+     */
+    void will_need(size_t _offset, size_t _length) const;
+
+    /**
+     * @brief      hint that a range of the file is no longer needed, such that
+     *             its pages are released; only pages which lie completely
+     *             within the range are released
+     *
+     * @param[in]  _offset  first byte of the range
+     * @param[in]  _length  length of the range in bytes
+     */
+    void dont_need(size_t _offset, size_t _length) const;
+};
+
+/**
+ * @brief      parse the header of a mapped NumPy (.npy) file holding a
+ *             three-dimensional array in C order
+ *
+ * @param[in]  _file        the mapped file
+ * @param[out] _dtype       element type as typecode and number of bytes
+ * @param[out] _dimensions  grid dimensions (nx, ny, nz), i.e. the reversed
+ *                          shape of the array
+ *
+ * @return     offset of the array data in bytes
+ */
+size_t read_npy_header(const MappedFile& _file, std::string& _dtype, std::vector<size_t>& _dimensions);
@@ -0,0 +1,491 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   PyTessel is free software:                                           *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   PyTessel is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "mesh_writers.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#include "parallel.h"
+
+// number of vertices or triangles formatted per block
+#define WRITE_BLOCK_SIZE (1 << 14)
+
+// maximum number of bytes of a single STL facet: the normal, three vertices
+// and the attribute (binary) or five lines of at most three numbers (ASCII)
+#define STL_BINARY_FACET_SIZE (12 * sizeof(float) + sizeof(uint16_t))
+#define STL_ASCII_FACET_SIZE (5 * (16 + 3 * 33))
+
+/**
+ * @brief      reference external buffers
+ *
+ * @param[in]  _vertices     vertices
+ * @param[in]  _normals      normals at the vertices
+ * @param[in]  _nr_vertices  number of vertices
+ * @param[in]  _indices      triangle indices
+ * @param[in]  _nr_indices   number of indices (three per triangle)
+ * @param[in]  _index_size   number of bytes per index (4 or 8)
+ */
+MeshBuffers::MeshBuffers(const float* _vertices, const float* _normals, size_t _nr_vertices,
+                         const void* _indices, size_t _nr_indices, size_t _index_size) :
+    vertices(_vertices),
+    normals(_normals),
+    nr_vertices(_nr_vertices),
+    indices(_indices),
+    nr_indices(_nr_indices),
+    index_size(_index_size) {}
+
+/**
+ * @brief      reference the buffers of an isosurface mesh
+ *
+ * @param[in]  _mesh  the mesh
+ */
+MeshBuffers::MeshBuffers(const IsoSurfaceMesh& _mesh) :
+    MeshBuffers(_mesh.get_vertices(), _mesh.get_normals(), _mesh.get_nr_vertices(),
+                _mesh.get_indices(), _mesh.get_nr_indices(), _mesh.get_index_size()) {}
+
+/**
+ * @brief      get a triangle index
+ *
+ * @param[in]  _mesh  the mesh
+ * @param[in]  _i     position of the index
+ *
+ * @return     the index
+ */
+static inline uint64_t get_index(const MeshBuffers& _mesh, size_t _i) {
+    return _mesh.index_size == sizeof(uint64_t) ? static_cast<const uint64_t*>(_mesh.indices)[_i] :
+                                                  static_cast<const uint32_t*>(_mesh.indices)[_i];
+}
+
+/**
+ * @brief      verify that the mesh consists of triangles referring to
+ *             existing vertices
+ *
+ * @param[in]  _mesh  the mesh
+ */
+static void validate_mesh(const MeshBuffers& _mesh) {
+    if(_mesh.index_size != sizeof(uint32_t) && _mesh.index_size != sizeof(uint64_t)) {
+        throw std::invalid_argument("Triangle indices should be 32 or 64 bit unsigned integers");
+    }
+    if(_mesh.nr_indices % 3 != 0) {
+        throw std::invalid_argument("Number of triangle indices should be a multiple of three");
+    }
+
+    std::atomic<bool> valid(true);
+    const size_t nblocks = (_mesh.nr_indices + WRITE_BLOCK_SIZE - 1) / WRITE_BLOCK_SIZE;
+    parallel_for(0, nblocks, [&](size_t b) {
+        const size_t end = std::min((b + 1) * WRITE_BLOCK_SIZE, _mesh.nr_indices);
+        for(size_t i=b * WRITE_BLOCK_SIZE; i<end; i++) {
+            if(get_index(_mesh, i) >= _mesh.nr_vertices) {
+                valid = false;
+                return;
+            }
+        }
+    });
+    if(!valid) {
+        throw std::invalid_argument("Triangle indices exceed the number of vertices");
+    }
+}
+
+/**
+ * @brief      store a value in little endian byte order
+ *
+ * @param      _dest   destination
+ * @param[in]  _value  the value
+ *
+ * @return     position after the value
+ */
+template<typename T>
+static inline char* store_le(char* _dest, T _value) {
+    static const uint16_t one = 1;
+    std::memcpy(_dest, &_value, sizeof(T));
+    if(*reinterpret_cast<const char*>(&one) != 1) {
+        std::reverse(_dest, _dest + sizeof(T));
+    }
+    return _dest + sizeof(T);
+}
+
+/**
+ * @brief      store the shortest representation of a float which reads back
+ *             to the same value, using std::to_chars where available
+ *
+ * @param      _dest        destination (at least 32 characters)
+ * @param[in]  _value       the value
+ * @param[in]  _scientific  whether to use scientific notation
+ *
+ * @return     position after the value
+ */
+static inline char* store_float(char* _dest, float _value, bool _scientific = false) {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    return std::to_chars(_dest, _dest + 32, _value,
+                         _scientific ? std::chars_format::scientific : std::chars_format::general).ptr;
+#else
+    return _dest + std::snprintf(_dest, 32, _scientific ? "%.8e" : "%.9g", _value);
+#endif
+}
+
+/**
+ * @brief      store an unsigned integer as text
+ *
+ * @param      _dest   destination (at least 24 characters)
+ * @param[in]  _value  the value
+ *
+ * @return     position after the value
+ */
+static inline char* store_uint(char* _dest, uint64_t _value) {
+    return std::to_chars(_dest, _dest + 24, _value).ptr;
+}
+
+/**
+ * @brief      format _nblocks blocks and write them in order; the blocks of
+ *             a batch are formatted in parallel, such that the memory used
+ *             for formatting is bounded
+ *
+ * @param      _out      output stream
+ * @param[in]  _nblocks  number of blocks
+ * @param[in]  _format   callable formatting a block into a (cleared)
+ *                       buffer: _format(block, buffer)
+ */
+template<typename F>
+static void write_batches(std::ofstream& _out, size_t _nblocks, F&& _format) {
+    const size_t batch = get_num_threads() * 4;
+    std::vector<std::string> buffers(std::min(batch, _nblocks));
+
+    for(size_t b0=0; b0<_nblocks; b0+=batch) {
+        const size_t b1 = std::min(b0 + batch, _nblocks);
+        parallel_for(b0, b1, [&](size_t b) {
+            std::string& buffer = buffers[b - b0];
+            buffer.clear();
+            _format(b, buffer);
+        }, Schedule::DYNAMIC);
+
+        for(size_t b=b0; b<b1; b++) {
+            _out.write(buffers[b - b0].data(), buffers[b - b0].size());
+        }
+    }
+}
+
+/**
+ * @brief      format the items [0, _count) in blocks of WRITE_BLOCK_SIZE
+ *             items and write them in order
+ *
+ * @param      _out     output stream
+ * @param[in]  _count   number of items
+ * @param[in]  _format  callable formatting the items [begin, end) into a
+ *                      (cleared) buffer: _format(begin, end, buffer)
+ */
+template<typename F>
+static void write_blocks(std::ofstream& _out, size_t _count, F&& _format) {
+    const size_t nblocks = (_count + WRITE_BLOCK_SIZE - 1) / WRITE_BLOCK_SIZE;
+    write_batches(_out, nblocks, [&](size_t _b, std::string& _buffer) {
+        _format(_b * WRITE_BLOCK_SIZE, std::min((_b + 1) * WRITE_BLOCK_SIZE, _count), _buffer);
+    });
+}
+
+/**
+ * @brief      open a file for writing
+ *
+ * @param[in]  _filename  path to the file
+ *
+ * @return     output stream
+ */
+static std::ofstream open_output(const std::string& _filename) {
+    std::ofstream out(_filename, std::ios::binary);
+    if(!out) {
+        throw std::runtime_error("Cannot open file for writing: " + _filename);
+    }
+    return out;
+}
+
+/**
+ * @brief      write a mesh as a PLY file
+ *
+ * @param[in]  _filename  path to the file
+ * @param[in]  _mesh      the mesh
+ * @param[in]  _binary    whether to write a binary file
+ */
+void write_ply(const std::string& _filename, const MeshBuffers& _mesh, bool _binary) {
+    validate_mesh(_mesh);
+    if(_mesh.nr_vertices > static_cast<size_t>(std::numeric_limits<uint32_t>::max()) + 1) {
+        throw std::invalid_argument("PLY files cannot hold more than 2^32 vertices");
+    }
+    const size_t nrtriangles = _mesh.nr_indices / 3;
+
+    std::ofstream out = open_output(_filename);
+    out << "ply\n"
+        << "format " << (_binary ? "binary_little_endian" : "ascii") << " 1.0\n"
+        << "comment generated by write_ply\n"
+        << "element vertex " << _mesh.nr_vertices << "\n"
+        << "property float x\n"
+        << "property float y\n"
+        << "property float z\n"
+        << "property float nx\n"
+        << "property float ny\n"
+        << "property float nz\n"
+        << "element face " << nrtriangles << "\n"
+        << "property list uchar uint vertex_indices\n"
+        << "end_header\n";
+
+    // vertices and normals are interleaved per vertex
+    write_blocks(out, _mesh.nr_vertices, [&](size_t _begin, size_t _end, std::string& _buffer) {
+        _buffer.resize((_end - _begin) * (_binary ? 6 * sizeof(float) : 6 * 32));
+        char* p = &_buffer[0];
+        for(size_t i=_begin; i<_end; i++) {
+            const float values[6] = {_mesh.vertices[i*3], _mesh.vertices[i*3+1], _mesh.vertices[i*3+2],
+                                     _mesh.normals[i*3], _mesh.normals[i*3+1], _mesh.normals[i*3+2]};
+            for(size_t j=0; j<6; j++) {
+                if(_binary) {
+                    p = store_le(p, values[j]);
+                } else {
+                    p = store_float(p, values[j]);
+                    *p++ = j < 5 ? ' ' : '\n';
+                }
+            }
+        }
+        _buffer.resize(p - _buffer.data());
+    });
+
+    // every face is a list of three vertex indices
+    write_blocks(out, nrtriangles, [&](size_t _begin, size_t _end, std::string& _buffer) {
+        _buffer.resize((_end - _begin) * (_binary ? 1 + 3 * sizeof(uint32_t) : 2 + 3 * 24));
+        char* p = &_buffer[0];
+        for(size_t t=_begin; t<_end; t++) {
+            if(_binary) {
+                *p++ = 3;
+                for(size_t j=0; j<3; j++) {
+                    p = store_le(p, static_cast<uint32_t>(get_index(_mesh, t*3 + j)));
+                }
+            } else {
+                *p++ = '3';
+                for(size_t j=0; j<3; j++) {
+                    *p++ = ' ';
+                    p = store_uint(p, get_index(_mesh, t*3 + j));
+                }
+                *p++ = '\n';
+            }
+        }
+        _buffer.resize(p - _buffer.data());
+    });
+
+    if(!out.flush()) {
+        throw std::runtime_error("Cannot write file: " + _filename);
+    }
+}
+
+/**
+ * @brief      store a single STL facet
+ *
+ * @param      _dest      destination (at least STL_BINARY_FACET_SIZE or
+ *                        STL_ASCII_FACET_SIZE bytes)
+ * @param[in]  _normal    the (unit) normal of the triangle
+ * @param[in]  _vertices  the three vertices of the triangle
+ * @param[in]  _binary    whether to store a binary rather than an ASCII
+ *                        facet
+ *
+ * @return     position after the facet
+ */
+static char* store_facet(char* _dest, const float _normal[3], const float* const _vertices[3], bool _binary) {
+    char* p = _dest;
+    if(_binary) {
+        for(size_t j=0; j<3; j++) {
+            p = store_le(p, _normal[j]);
+        }
+        for(size_t k=0; k<3; k++) {
+            for(size_t j=0; j<3; j++) {
+                p = store_le(p, _vertices[k][j]);
+            }
+        }
+        return store_le(p, static_cast<uint16_t>(0));
+    }
+
+    static const char facet[] = "  facet normal";
+    p = std::copy(facet, facet + sizeof(facet) - 1, p);
+    for(size_t j=0; j<3; j++) {
+        *p++ = ' ';
+        p = store_float(p, _normal[j], true);
+    }
+    static const char loop[] = "\n    outer loop\n";
+    p = std::copy(loop, loop + sizeof(loop) - 1, p);
+    for(size_t k=0; k<3; k++) {
+        static const char vertex[] = "      vertex";
+        p = std::copy(vertex, vertex + sizeof(vertex) - 1, p);
+        for(size_t j=0; j<3; j++) {
+            *p++ = ' ';
+            p = store_float(p, _vertices[k][j], true);
+        }
+        *p++ = '\n';
+    }
+    static const char endloop[] = "    endloop\n  endfacet\n";
+    return std::copy(endloop, endloop + sizeof(endloop) - 1, p);
+}
+
+/**
+ * @brief      write the header of an STL file
+ *
+ * @param      _out          output stream
+ * @param[in]  _nrtriangles  number of triangles (binary files only)
+ * @param[in]  _binary       whether to write a binary file
+ */
+static void write_stl_header(std::ofstream& _out, size_t _nrtriangles, bool _binary) {
+    if(_binary) {
+        char header[84] = "Generated by write_stl";
+        store_le(header + 80, static_cast<uint32_t>(_nrtriangles));
+        _out.write(header, sizeof(header));
+    } else {
+        _out << "solid pytessel\n";
+    }
+}
+
+/**
+ * @brief      finish an STL file and verify that it has been written
+ *
+ * @param      _out       output stream
+ * @param[in]  _filename  path to the file
+ * @param[in]  _binary    whether a binary file is written
+ */
+static void finish_stl(std::ofstream& _out, const std::string& _filename, bool _binary) {
+    if(!_binary) {
+        _out << "endsolid pytessel\n";
+    }
+
+    if(!_out.flush()) {
+        throw std::runtime_error("Cannot write file: " + _filename);
+    }
+}
+
+/**
+ * @brief      write a mesh as an STL file
+ *
+ * @param[in]  _filename  path to the file
+ * @param[in]  _mesh      the mesh
+ * @param[in]  _binary    whether to write a binary file
+ */
+void write_stl(const std::string& _filename, const MeshBuffers& _mesh, bool _binary) {
+    validate_mesh(_mesh);
+    const size_t nrtriangles = _mesh.nr_indices / 3;
+    if(_binary && nrtriangles > std::numeric_limits<uint32_t>::max()) {
+        throw std::invalid_argument("Binary STL files cannot hold more than 2^32 - 1 triangles");
+    }
+
+    std::ofstream out = open_output(_filename);
+    write_stl_header(out, nrtriangles, _binary);
+
+    write_blocks(out, nrtriangles, [&](size_t _begin, size_t _end, std::string& _buffer) {
+        _buffer.resize((_end - _begin) * (_binary ? STL_BINARY_FACET_SIZE : STL_ASCII_FACET_SIZE));
+        char* p = &_buffer[0];
+        for(size_t t=_begin; t<_end; t++) {
+            // the normal of the facet is the normalized sum of the normals
+            // at its vertices
+            const float* vertices[3];
+            float normal[3] = {0.0f, 0.0f, 0.0f};
+            for(size_t k=0; k<3; k++) {
+                const uint64_t v = get_index(_mesh, t*3 + k);
+                vertices[k] = _mesh.vertices + v * 3;
+                for(size_t j=0; j<3; j++) {
+                    normal[j] += _mesh.normals[v * 3 + j];
+                }
+            }
+            float norm = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            if(norm == 0.0f) {
+                norm = 1.0f;
+            }
+            for(size_t j=0; j<3; j++) {
+                normal[j] /= norm;
+            }
+            p = store_facet(p, normal, vertices, _binary);
+        }
+        _buffer.resize(p - _buffer.data());
+    });
+
+    finish_stl(out, _filename, _binary);
+}
+
+/**
+ * @brief      construct the isosurface of a scalar field using the marching
+ *             cubes algorithm and write its triangles directly to an STL file
+ *
+ * @param[in]  _sf        the scalar field
+ * @param[in]  _isovalue  The isovalue
+ * @param[in]  _filename  path to the file
+ * @param[in]  _binary    whether to write a binary file
+ *
+ * @return     number of triangles
+ */
+size_t marching_cubes_to_stl(const std::shared_ptr<ScalarField>& _sf, float _isovalue,
+                             const std::string& _filename, bool _binary) {
+    const IsoSurface isosurface(_sf);
+    _sf->build_bricks();
+
+    // the number of triangles of a binary file is filled in afterwards
+    std::ofstream out = open_output(_filename);
+    write_stl_header(out, 0, _binary);
+
+    // the structure is centered in the same way as the meshes
+    const Vec3 center = _sf->get_mat_unitcell() * Vec3(0.5f, 0.5f, 0.5f);
+
+    // every slab of cubes is triangulated and formatted as a single block
+    size_t dimensions[3];
+    _sf->copy_grid_dimensions(dimensions);
+    const size_t nslabs = dimensions[2] - 1;
+    std::vector<size_t> slab_triangles(nslabs);
+    write_batches(out, nslabs, [&](size_t _z, std::string& _buffer) {
+        std::vector<Vec3> vertices;
+        std::vector<Vec3> normals;
+        isosurface.triangulate_slab(_z, _isovalue, vertices, normals);
+        slab_triangles[_z] = vertices.size() / 3;
+        for(Vec3& vertex : vertices) {
+            vertex -= center;
+        }
+
+        _buffer.resize(slab_triangles[_z] * (_binary ? STL_BINARY_FACET_SIZE : STL_ASCII_FACET_SIZE));
+        char* p = &_buffer[0];
+        for(size_t t=0; t<slab_triangles[_z]; t++) {
+            const float* const v[3] = {&vertices[t*3].x, &vertices[t*3+1].x, &vertices[t*3+2].x};
+            p = store_facet(p, &normals[t].x, v, _binary);
+        }
+        _buffer.resize(p - _buffer.data());
+    });
+
+    size_t nrtriangles = 0;
+    for(size_t count : slab_triangles) {
+        nrtriangles += count;
+    }
+
+    if(_binary) {
+        if(nrtriangles > std::numeric_limits<uint32_t>::max()) {
+            throw std::invalid_argument("Binary STL files cannot hold more than 2^32 - 1 triangles");
+        }
+        char count[sizeof(uint32_t)];
+        store_le(count, static_cast<uint32_t>(nrtriangles));
+        out.seekp(80);
+        out.write(count, sizeof(count));
+    }
+
+    finish_stl(out, _filename, _binary);
+
+    return nrtriangles;
+}
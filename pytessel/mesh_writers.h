@@ -0,0 +1,104 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   PyTessel is free software:                                           *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   PyTessel is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "isosurface_mesh.h"
+
+/**
+ * @brief      buffers of a triangle mesh which is written to a file: the
+ *             vertices and normals as consecutive (x,y,z) triplets of floats
+ *             and the triangle indices as 32 or 64 bit unsigned integers
+ */
+struct MeshBuffers {
+    const float* vertices;
+    const float* normals;
+    size_t nr_vertices;
+    const void* indices;
+    size_t nr_indices;
+    size_t index_size;          // number of bytes per index (4 or 8)
+
+    /**
+     * @brief      reference external buffers
+     *
+     * @param[in]  _vertices     vertices
+     * @param[in]  _normals      normals at the vertices
+     * @param[in]  _nr_vertices  number of vertices
+     * @param[in]  _indices      triangle indices
+     * @param[in]  _nr_indices   number of indices (three per triangle)
+     * @param[in]  _index_size   number of bytes per index (4 or 8)
+     */
+    MeshBuffers(const float* _vertices, const float* _normals, size_t _nr_vertices,
+                const void* _indices, size_t _nr_indices, size_t _index_size);
+
+    /**
+     * @brief      reference the buffers of an isosurface mesh
+     *
+     * @param[in]  _mesh  the mesh
+     */
+    explicit MeshBuffers(const IsoSurfaceMesh& _mesh);
+};
+
+/**
+ * @brief      write a mesh as a PLY file holding the vertices, the normals
+ *             and the triangles
+ *
+ * @param[in]  _filename  path to the file
+ * @param[in]  _mesh      the mesh
+ * @param[in]  _binary    whether to write a (little endian) binary file
+ *                        rather than an ASCII file
+ */
+void write_ply(const std::string& _filename, const MeshBuffers& _mesh, bool _binary = true);
+
+/**
+ * @brief      write a mesh as an STL file holding the triangles; the normal
+ *             of every triangle is the normalized sum of the normals at its
+ *             vertices
+ *
+ * @param[in]  _filename  path to the file
+ * @param[in]  _mesh      the mesh
+ * @param[in]  _binary    whether to write a binary file rather than an ASCII
+ *                        file
+ */
+void write_stl(const std::string& _filename, const MeshBuffers& _mesh, bool _binary = true);
+
+/**
+ * @brief      construct the isosurface of a scalar field using the marching
+ *             cubes algorithm and write its triangles directly to an STL
+ *             file, slab by slab, without building the vertex table or the
+ *             mesh; the triangles are the same as those of the (centered)
+ *             mesh of IsoSurface::marching_cubes, but the normal of every
+ *             facet is calculated from the gradient of the grid at the
+ *             centroid of the triangle
+ *
+ * @param[in]  _sf        the scalar field
+ * @param[in]  _isovalue  The isovalue
+ * @param[in]  _filename  path to the file
+ * @param[in]  _binary    whether to write a binary file rather than an ASCII
+ *                        file
+ *
+ * @return     number of triangles
+ */
+size_t marching_cubes_to_stl(const std::shared_ptr<ScalarField>& _sf, float _isovalue,
+                             const std::string& _filename, bool _binary = true);
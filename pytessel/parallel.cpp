@@ -0,0 +1,238 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   PyTessel is free software:                                           *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   PyTessel is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// requested number of threads for loops started from this thread (0: default)
+static thread_local size_t requested_threads = 0;
+
+// whether this thread is executing (part of) a parallel loop
+static thread_local bool in_parallel_loop = false;
+
+/**
+ * @brief      set the number of threads used by parallel loops started from
+ *             the calling thread
+ *
+ * @param[in]  _nthreads  number of threads; 0 restores the default
+ */
+void set_num_threads(size_t _nthreads) {
+    requested_threads = _nthreads;
+}
+
+/**
+ * @brief      get the number of threads used by parallel loops started from
+ *             the calling thread
+ *
+ * @return     number of threads
+ */
+size_t get_num_threads() {
+    if(requested_threads != 0) {
+        return requested_threads;
+    }
+#ifdef _OPENMP
+    return static_cast<size_t>(omp_get_max_threads());
+#else
+    return std::max<size_t>(1, std::thread::hardware_concurrency());
+#endif
+}
+
+SerialRegion::SerialRegion() : previous(requested_threads) {
+    requested_threads = 1;
+}
+
+SerialRegion::~SerialRegion() {
+    requested_threads = this->previous;
+}
+
+/**
+ * @brief      get the name of the backend used for parallel loops
+ *
+ * @return     "openmp" or "threads"
+ */
+const char* get_parallel_backend() {
+#ifdef _OPENMP
+    return "openmp";
+#else
+    return "threads";
+#endif
+}
+
+namespace {
+
+/**
+ * @brief      pool of worker threads shared by the parallel loops of all
+ *             calling threads
+ *
+ * Every loop is submitted as a job on a shared queue; idle workers join the
+ * job at the front of the queue until the job has no open slots left. The
+ * calling thread participates in its own loop, such that loops submitted
+ * concurrently by independent threads progress side by side (and do not
+ * wait for each other when all workers are busy). Workers are only started
+ * when a loop requests more threads than are available. The chunks of a
+ * loop are claimed from an atomic counter, such that idle threads pick up
+ * the next available chunk.
+ */
+class ThreadPool {
+private:
+    /**
+     * @brief      state of a single parallel loop
+     */
+    struct Job {
+        const std::function<void(size_t, size_t)>* body = nullptr;
+        std::atomic<size_t> next{0};
+        size_t end = 0;
+        size_t chunksize = 1;
+        size_t open_slots = 0;              // number of workers which may still join
+        size_t active = 0;                  // number of workers executing chunks
+        std::exception_ptr error;
+    };
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;                       // protects the state below
+    std::condition_variable cv_job;
+    std::condition_variable cv_done;
+    std::deque<Job*> queue;                 // jobs with open slots
+
+public:
+    /**
+     * @brief      get the pool; the pool is never destroyed such that no
+     *             threads are joined while the library is unloaded
+     */
+    static ThreadPool& get() {
+        static ThreadPool* pool = new ThreadPool();
+        return *pool;
+    }
+
+    /**
+     * @brief      execute a loop using (at most) _nthreads threads
+     */
+    void run(size_t _nthreads, size_t _begin, size_t _end, size_t _chunksize,
+             const std::function<void(size_t, size_t)>& _body) {
+        Job job;
+        job.body = &_body;
+        job.next.store(_begin);
+        job.end = _end;
+        job.chunksize = std::max<size_t>(1, _chunksize);
+        job.open_slots = _nthreads - 1;
+
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            while(this->workers.size() < _nthreads - 1) {
+                this->workers.emplace_back(&ThreadPool::worker_loop, this);
+            }
+            this->queue.push_back(&job);
+        }
+        this->cv_job.notify_all();
+
+        in_parallel_loop = true;
+        this->execute_chunks(job);
+        in_parallel_loop = false;
+
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            if(job.open_slots != 0) {
+                this->queue.erase(std::find(this->queue.begin(), this->queue.end(), &job));
+                job.open_slots = 0;
+            }
+            this->cv_done.wait(lock, [&job] { return job.active == 0; });
+        }
+
+        if(job.error) {
+            std::rethrow_exception(job.error);
+        }
+    }
+
+private:
+    /**
+     * @brief      claim and execute chunks until the loop is exhausted
+     */
+    void execute_chunks(Job& _job) {
+        for(;;) {
+            const size_t b = _job.next.fetch_add(_job.chunksize);
+            if(b >= _job.end) {
+                return;
+            }
+            try {
+                (*_job.body)(b, std::min(b + _job.chunksize, _job.end));
+            } catch(...) {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                if(!_job.error) {
+                    _job.error = std::current_exception();
+                }
+                _job.next.store(_job.end);
+            }
+        }
+    }
+
+    /**
+     * @brief      main loop of a worker thread
+     */
+    void worker_loop() {
+        in_parallel_loop = true;
+        std::unique_lock<std::mutex> lock(this->mutex);
+        for(;;) {
+            this->cv_job.wait(lock, [this] { return !this->queue.empty(); });
+            Job& job = *this->queue.front();
+            if(--job.open_slots == 0) {
+                this->queue.pop_front();
+            }
+            job.active++;
+            lock.unlock();
+            this->execute_chunks(job);
+            lock.lock();
+            if(--job.active == 0) {
+                this->cv_done.notify_all();
+            }
+        }
+    }
+};
+
+} // namespace
+
+/**
+ * @brief      execute [_begin, _end) in chunks of _chunksize iterations on
+ *             the thread pool
+ *
+ * Loops started from within a parallel loop, or requesting a single
+ * thread, are executed serially by the calling thread.
+ *
+ * @param[in]  _begin      first iteration
+ * @param[in]  _end        one past the last iteration
+ * @param[in]  _chunksize  number of iterations handed out at once
+ * @param[in]  _body       function executing the iterations [begin, end)
+ */
+void thread_pool_for(size_t _begin, size_t _end, size_t _chunksize,
+                     const std::function<void(size_t, size_t)>& _body) {
+    const size_t nthreads = std::min(get_num_threads(), _end - _begin);
+    if(nthreads <= 1 || in_parallel_loop) {
+        _body(_begin, _end);
+        return;
+    }
+    ThreadPool::get().run(nthreads, _begin, _end, _chunksize, _body);
+}
@@ -0,0 +1,194 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   PyTessel is free software:                                           *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   PyTessel is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+
+#include "trace.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+ * Parallel loops over a range of indices. When the library is compiled with
+ * OpenMP, the loops are distributed using OpenMP; otherwise a built-in pool
+ * of std::threads is used, such that builds without OpenMP support (e.g.
+ * using Apple clang) are not limited to a single thread.
+ *
+ * The number of threads is set per calling thread (analogous to
+ * omp_set_num_threads) and applies to all parallel loops started from that
+ * thread. Parallel loops started from within a parallel loop are executed
+ * serially.
+ *
+ * When a trace buffer is set for the calling thread (see trace.h), every
+ * chunk of iterations is recorded as an event on the executing thread.
+ */
+
+/**
+ * @brief      how the iterations of a parallel loop are distributed
+ *
+ * STATIC:  every thread receives a single contiguous block of iterations
+ * DYNAMIC: iterations are handed out one at a time to idle threads
+ */
+enum class Schedule {
+    STATIC,
+    DYNAMIC
+};
+
+/**
+ * @brief      set the number of threads used by parallel loops started from
+ *             the calling thread
+ *
+ * @param[in]  _nthreads  number of threads; 0 restores the default
+ */
+void set_num_threads(size_t _nthreads);
+
+/**
+ * @brief      get the number of threads used by parallel loops started from
+ *             the calling thread
+ *
+ * @return     number of threads
+ */
+size_t get_num_threads();
+
+/**
+ * @brief      executes all parallel loops started from the calling thread
+ *             serially for as long as the object exists, e.g. when the
+ *             calling thread is itself part of a parallel loop over
+ *             independent tasks
+ */
+class SerialRegion {
+private:
+    size_t previous;    // requested number of threads before the region
+
+public:
+    SerialRegion();
+
+    ~SerialRegion();
+
+    SerialRegion(const SerialRegion&) = delete;
+
+    SerialRegion& operator=(const SerialRegion&) = delete;
+};
+
+/**
+ * @brief      get the name of the backend used for parallel loops
+ *
+ * @return     "openmp" or "threads"
+ */
+const char* get_parallel_backend();
+
+/**
+ * @brief      execute [_begin, _end) in chunks of _chunksize iterations on
+ *             the thread pool
+ *
+ * @param[in]  _begin      first iteration
+ * @param[in]  _end        one past the last iteration
+ * @param[in]  _chunksize  number of iterations handed out at once
+ * @param[in]  _body       function executing the iterations [begin, end)
+ */
+void thread_pool_for(size_t _begin, size_t _end, size_t _chunksize,
+                     const std::function<void(size_t, size_t)>& _body);
+
+/**
+ * @brief      execute _body(i) for every i in [_begin, _end) in parallel
+ *             without recording trace events
+ *
+ * @param[in]  _begin     first iteration
+ * @param[in]  _end       one past the last iteration
+ * @param[in]  _body      loop body
+ * @param[in]  _schedule  distribution of the iterations over the threads
+ */
+template<typename F>
+inline void parallel_for_untraced(size_t _begin, size_t _end, F&& _body, Schedule _schedule) {
+#ifdef _OPENMP
+    const int nthreads = static_cast<int>(get_num_threads());
+    if(_schedule == Schedule::DYNAMIC) {
+        #pragma omp parallel for schedule(dynamic) num_threads(nthreads)
+        for(size_t i=_begin; i<_end; i++) {
+            _body(i);
+        }
+    } else {
+        #pragma omp parallel for schedule(static) num_threads(nthreads)
+        for(size_t i=_begin; i<_end; i++) {
+            _body(i);
+        }
+    }
+#else
+    const size_t nthreads = get_num_threads();
+    const size_t chunksize = (_schedule == Schedule::DYNAMIC) ? 1 : (_end - _begin + nthreads - 1) / nthreads;
+    thread_pool_for(_begin, _end, chunksize, [&_body](size_t b, size_t e) {
+        for(size_t i=b; i<e; i++) {
+            _body(i);
+        }
+    });
+#endif
+}
+
+/**
+ * @brief      execute _body(i) for every i in [_begin, _end) in parallel
+ *
+ * @param[in]  _begin     first iteration
+ * @param[in]  _end       one past the last iteration
+ * @param[in]  _body      loop body
+ * @param[in]  _schedule  distribution of the iterations over the threads
+ */
+template<typename F>
+inline void parallel_for(size_t _begin, size_t _end, F&& _body, Schedule _schedule = Schedule::STATIC) {
+    if(_begin >= _end) {
+        return;
+    }
+
+    TraceBuffer* trace = get_trace_buffer();
+    if(trace == nullptr) {
+        parallel_for_untraced(_begin, _end, _body, _schedule);
+        return;
+    }
+
+    // split the loop into the chunks handed out to the threads, i.e. a
+    // single block per thread (static) or single iterations (dynamic), and
+    // record every chunk; the executing threads inherit the trace buffer such
+    // that phases of nested (serial) algorithms are recorded as well
+    const char* phase = get_trace_phase() != nullptr ? get_trace_phase() : "parallel_for";
+    const size_t n = _end - _begin;
+    const size_t nchunks = (_schedule == Schedule::DYNAMIC) ? n : std::min(n, get_num_threads());
+    parallel_for_untraced(0, nchunks, [&](size_t c) {
+        TraceBuffer* prev_trace = get_trace_buffer();
+        const char* prev_phase = get_trace_phase();
+        set_trace_buffer(trace);
+        set_trace_phase(phase);
+
+        const size_t b = _begin + c * n / nchunks;
+        const size_t e = _begin + (c + 1) * n / nchunks;
+        const auto start = std::chrono::steady_clock::now();
+        for(size_t i=b; i<e; i++) {
+            _body(i);
+        }
+        trace->record(phase, "chunk", start, std::chrono::steady_clock::now(), b, e);
+
+        set_trace_buffer(prev_trace);
+        set_trace_phase(prev_phase);
+    }, _schedule);
+}
@@ -6,24 +6,108 @@
 from libcpp.vector cimport vector
 from libcpp.string cimport string
 from libcpp.memory cimport shared_ptr
+from libcpp.pair cimport pair
+from libc.stdint cimport uint64_t
+
+# Memory-mapped files
+cdef extern from "mapped_file.h" nogil:
+    cdef cppclass MappedFile:
+        MappedFile(string) except +
+    size_t read_npy_header(const MappedFile&, string&, vector[size_t]&) except +
 
 # Scalar Field class
-cdef extern from "scalar_field.h":
+cdef extern from "scalar_field.h" nogil:
     cdef cppclass ScalarField:
         ScalarField(vector[float], vector[uint], vector[float]) except +
+        ScalarField(const void*, string, vector[size_t], vector[float]) except +
+        ScalarField(shared_ptr[MappedFile], size_t, string, vector[size_t], vector[float]) except +
+        void build_gradients() except +
+        void release_gradients()
+        const void* get_data()
+        void copy_grid_dimensions(size_t*)
+        vector[float] get_unitcell_vf()
+
+# File readers
+cdef extern from "field_readers.h" nogil:
+    shared_ptr[ScalarField] cpp_read_cube "read_cube"(string) except +
+    shared_ptr[ScalarField] cpp_read_chgcar "read_chgcar"(string, bint) except +
+
+# Timings and counters
+cdef extern from "extraction_stats.h" nogil:
+    cdef cppclass ExtractionStats:
+        const vector[pair[string, double]]& get_timings()
+        const vector[pair[string, uint64_t]]& get_counters()
 
 # Isosurface class
-cdef extern from "isosurface.h":
+cdef extern from "isosurface.h" nogil:
+    cdef enum class ExtractionMethod:
+        CUBES
+        STREAMING
+        BRICKS
+        FLYING_EDGES
+        TETRAHEDRA
+
     cdef cppclass IsoSurface:
         IsoSurface(shared_ptr[ScalarField *] _sf) except +
+        void extract(float, ExtractionMethod) except+
         void marching_cubes(float) except+
+        void marching_cubes_streaming(float) except+
+        void marching_cubes_tiled(float, size_t) except+
+        void marching_cubes_bricked(float) except+
+        void flying_edges(float) except+
+        void set_compute_normals(bint)
+        void marching_tetrahedra(float) except+
+        const ExtractionStats& get_stats()
+        @staticmethod
+        vector[shared_ptr[IsoSurface]] marching_cubes_multi(shared_ptr[ScalarField], vector[float], bint) except+
 
 # Isosurface Mesh class
-cdef extern from "isosurface_mesh.h":
+cdef extern from "isosurface_mesh.h" nogil:
     cdef cppclass IsoSurfaceMesh:
         IsoSurfaceMesh(const shared_ptr[ScalarField *] _sf, const shared_ptr[IsoSurface *] _is) except +
         IsoSurfaceMesh(vector[float], vector[float], vector[size_t]) except +
         void construct_mesh(bool) except+
-        vector[float] get_vertices() except+
-        vector[float] get_normals() except+
-        vector[size_t] get_indices() except+
+        const float* get_vertices()
+        const float* get_normals()
+        size_t get_nr_vertices()
+        const void* get_indices()
+        size_t get_nr_indices()
+        size_t get_index_size()
+        const ExtractionStats& get_stats()
+
+# Mesh writers
+cdef extern from "mesh_writers.h" nogil:
+    cdef cppclass MeshBuffers:
+        MeshBuffers(const float*, const float*, size_t, const void*, size_t, size_t)
+    void cpp_write_ply "write_ply"(string, const MeshBuffers&, bint) except +
+    void cpp_write_stl "write_stl"(string, const MeshBuffers&, bint) except +
+    size_t cpp_marching_cubes_to_stl "marching_cubes_to_stl"(const shared_ptr[ScalarField]&, float, string, bint) except +
+
+# Batched extraction
+cdef extern from "isosurface_batch.h" nogil:
+    shared_ptr[IsoSurfaceMesh] marching_cubes_batch(vector[shared_ptr[ScalarField]], vector[float], ExtractionMethod,
+                                                    bint, bint, vector[size_t]&, vector[size_t]&) except+
+
+# Extraction session
+cdef extern from "tessellator.h" nogil:
+    cdef cppclass CppTessellator "Tessellator":
+        CppTessellator(shared_ptr[ScalarField], ExtractionMethod, bint, bint) except +
+        shared_ptr[IsoSurfaceMesh] extract(float) except+
+        const shared_ptr[IsoSurface]& get_isosurface()
+
+# Tracing
+cdef extern from "trace.h" nogil:
+    cdef cppclass TraceBuffer:
+        TraceBuffer() except +
+        void write_chrome_trace(string) except +
+    void set_trace_buffer(TraceBuffer*)
+
+# Parallel loops
+cdef extern from "parallel.h":
+    void set_num_threads(size_t)
+    size_t get_num_threads()
+    const char* get_parallel_backend()
+
+# Cell classification
+cdef extern from "cell_classifier.h":
+    const char* get_classifier_isa()
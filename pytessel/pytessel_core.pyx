@@ -7,40 +7,340 @@ from .pytessel_core cimport ScalarField, IsoSurface
 from libcpp.string cimport string
 from libcpp.memory cimport shared_ptr,make_shared
 import numpy as np
-import sys
 import cython
 import numpy.typing as npt
+import os
+import threading
+from concurrent.futures import Future, ThreadPoolExecutor
 
-cdef class PyTessel:
+# data types of the scalar field which are used without copying
+_SUPPORTED_DTYPES = ('f4', 'f8', 'i1', 'u1', 'i2', 'u2', 'i4', 'u4')
+
+def _as_grid(grid, dimensions):
+    """
+    Return the scalar field as a flat, C-contiguous array in native byte
+    order; arrays of a supported data type are returned without copying,
+    other input is converted to single precision
+    """
+    grid = np.asarray(grid)
+    if grid.dtype.str[1:] not in _SUPPORTED_DTYPES:
+        grid = grid.astype(np.float32)
+    elif not grid.dtype.isnative:
+        grid = grid.astype(grid.dtype.newbyteorder('='))
+    grid = np.ascontiguousarray(grid).reshape(-1)
+
+    if len(dimensions) != 3 or grid.size != np.prod(dimensions) or grid.size == 0:
+        raise ValueError("Size of the scalar field (%i) does not match its dimensions %s" %
+                         (grid.size, tuple(dimensions)))
+
+    return grid
+
+cdef shared_ptr[ScalarField] _scalar_field(grid, vector[size_t] dimensions, vector[float] unitcell) except *:
+    """
+    Build a scalar field referencing the data of a flat array (see
+    _as_grid); the array needs to be kept alive by the caller
+    """
+    cdef const unsigned char[::1] buffer = grid.view(np.uint8)
+    cdef string dtype = grid.dtype.str[1:]
+
+    return make_shared[ScalarField](<const void*>&buffer[0], dtype, dimensions, unitcell)
+
+cdef const void* _array_data(array) except? NULL:
+    """
+    Return a pointer to the data of a C-contiguous array, or NULL when the
+    array is empty; the array needs to be kept alive by the caller
+    """
+    cdef const unsigned char[::1] buffer
+
+    if array.size == 0:
+        return NULL
+
+    buffer = array.reshape(-1).view(np.uint8)
+    return <const void*>&buffer[0]
+
+cdef bint _grid_normals(shared_ptr[ScalarField] scalarfield, str normals) except -1:
+    """
+    Return whether the normals are calculated from the gradient on the grid
+    while extracting the isosurface; builds the gradient volume if requested
+    """
+    if normals not in ("gradient", "cached", "interpolate"):
+        raise ValueError("Unknown normals: %s" % normals)
+
+    if normals == "cached":
+        with nogil:
+            scalarfield.get().build_gradients()
 
-    def __cinit__(self):
+    return normals != "interpolate"
+
+cdef ExtractionMethod _extraction_method(str method) except *:
+    """
+    Return the extraction algorithm corresponding to the name of a method
+    of marching_cubes
+    """
+    if method == "streaming":
+        return ExtractionMethod.STREAMING
+    elif method == "bricks":
+        return ExtractionMethod.BRICKS
+    elif method == "flying_edges":
+        return ExtractionMethod.FLYING_EDGES
+    elif method == "cubes":
+        return ExtractionMethod.CUBES
+
+    raise ValueError("Unknown method: %s" % method)
+
+cdef class _MeshBuffer:
+    """
+    Exposes a single buffer of an isosurface mesh (or the grid of a scalar
+    field) through the buffer protocol, such that a NumPy array can share
+    its memory; the mesh is kept alive for as long as the array exists
+    """
+    cdef shared_ptr[IsoSurfaceMesh] mesh
+    cdef shared_ptr[ScalarField] field
+    cdef void* data
+    cdef Py_ssize_t shape[3]
+    cdef Py_ssize_t strides[3]
+    cdef int ndim
+    cdef bytes format
+
+    def __getbuffer__(self, Py_buffer* buffer, int flags):
+        buffer.buf = self.data
+        buffer.format = self.format
+        buffer.internal = NULL
+        buffer.itemsize = self.strides[self.ndim - 1]
+        buffer.len = self.shape[0] * self.strides[0]
+        buffer.ndim = self.ndim
+        buffer.obj = self
+        buffer.readonly = 0
+        buffer.shape = self.shape
+        buffer.strides = self.strides
+        buffer.suboffsets = NULL
+
+    def __releasebuffer__(self, Py_buffer* buffer):
         pass
 
+cdef object _mesh_array(shared_ptr[IsoSurfaceMesh] mesh, const void* data, size_t length, size_t width,
+                        size_t itemsize, bytes format):
+    """
+    Wrap a buffer of an isosurface mesh as a NumPy array of shape
+    (length, width) or (length,) when width equals zero
+    """
+    cdef _MeshBuffer buffer
+
+    if length == 0 and width:
+        return np.empty((0, width), dtype=format.decode())
+    if length == 0:
+        return np.empty(0, dtype=format.decode())
+
+    buffer = _MeshBuffer()
+    buffer.mesh = mesh
+    buffer.data = <void*>data
+    buffer.format = format
+    buffer.ndim = 2 if width else 1
+    buffer.shape[0] = length
+    buffer.shape[1] = width
+    buffer.strides[0] = itemsize * (width if width else 1)
+    buffer.strides[1] = itemsize
+
+    return np.asarray(buffer)
+
+cdef tuple _field_arrays(shared_ptr[ScalarField] scalarfield):
+    """
+    Expose the grid of a scalar field as an array of shape (nz, ny, nx)
+    without copying, together with its unitcell matrix
+    """
+    cdef _MeshBuffer buffer = _MeshBuffer()
+    cdef size_t dimensions[3]
+
+    scalarfield.get().copy_grid_dimensions(dimensions)
+    buffer.field = scalarfield
+    buffer.data = <void*>scalarfield.get().get_data()
+    buffer.format = b'f'
+    buffer.ndim = 3
+    buffer.shape[0] = dimensions[2]
+    buffer.shape[1] = dimensions[1]
+    buffer.shape[2] = dimensions[0]
+    buffer.strides[2] = sizeof(float)
+    buffer.strides[1] = sizeof(float) * dimensions[0]
+    buffer.strides[0] = sizeof(float) * dimensions[0] * dimensions[1]
+
+    unitcell = np.array(scalarfield.get().get_unitcell_vf(), dtype=np.float32).reshape(3, 3)
+
+    return np.asarray(buffer), unitcell
+
+cdef dict _stats_dict(shared_ptr[IsoSurface] isosurface, shared_ptr[IsoSurfaceMesh] isosurface_mesh):
+    """
+    Collect the time spent per phase and the counters of the construction
+    of an isosurface and its mesh
+    """
+    cdef vector[pair[string, double]] timings = isosurface.get().get_stats().get_timings()
+    cdef vector[pair[string, uint64_t]] counters = isosurface.get().get_stats().get_counters()
+
+    timings.insert(timings.end(), isosurface_mesh.get().get_stats().get_timings().begin(),
+                   isosurface_mesh.get().get_stats().get_timings().end())
+    counters.insert(counters.end(), isosurface_mesh.get().get_stats().get_counters().begin(),
+                    isosurface_mesh.get().get_stats().get_counters().end())
+
+    stats = {"time": {}}
+    for phase, seconds in timings:
+        stats["time"][phase] = stats["time"].get(phase, 0.0) + seconds
+    stats["time"]["total"] = sum(stats["time"].values())
+    for name, value in counters:
+        stats[name] = stats.get(name, 0) + value
+
+    return stats
+
+cdef tuple _mesh_arrays(shared_ptr[IsoSurfaceMesh] isosurface_mesh):
+    """
+    Expose the vertices, normals and indices of a mesh without copying
+    """
+    nrvertices = isosurface_mesh.get().get_nr_vertices()
+    vertices = _mesh_array(isosurface_mesh, isosurface_mesh.get().get_vertices(), nrvertices, 3,
+                           sizeof(float), b'f')
+    normals = _mesh_array(isosurface_mesh, isosurface_mesh.get().get_normals(), nrvertices, 3,
+                          sizeof(float), b'f')
+    indices = _mesh_array(isosurface_mesh, isosurface_mesh.get().get_indices(),
+                          isosurface_mesh.get().get_nr_indices(), 0, isosurface_mesh.get().get_index_size(),
+                          b'I' if isosurface_mesh.get().get_index_size() == 4 else b'Q')
+
+    return vertices, normals, indices
+
+cdef class PyTessel:
+    """
+    Construction of isosurfaces from scalar fields
+
+    Parameters
+    ----------
+    num_threads : int, optional
+        Number of threads used to construct the isosurfaces; by default,
+        all available cores are used (or the value of OMP_NUM_THREADS when
+        built with OpenMP)
+    trace_file : str, optional
+        Path to a Chrome trace (JSON) to which the phases of the algorithms
+        and the chunks of work executed by every thread are written after
+        every extraction; open it using chrome://tracing or
+        https://ui.perfetto.dev to inspect the load balance. The most recent
+        events (up to 262144) are retained. Tracing is disabled by default.
+    """
+    cdef size_t _num_threads
+    cdef object _executor
+    cdef object _trace_file
+    cdef shared_ptr[TraceBuffer] _trace
+
+    def __cinit__(self, num_threads = None, trace_file = None):
+        if num_threads is None:
+            self._num_threads = 0
+        elif num_threads < 1:
+            raise ValueError("Number of threads should be at least one: %s" % num_threads)
+        else:
+            self._num_threads = num_threads
+
+        if trace_file is not None:
+            self._trace_file = os.fspath(trace_file)
+            self._trace = make_shared[TraceBuffer]()
+
+    def __dealloc__(self):
+        # the background thread exits once the pending isosurfaces have been
+        # constructed; it is not joined as the object may be released by the
+        # background thread itself
+        if self._executor is not None:
+            self._executor.shutdown(wait=False)
+
+    cdef void _start_trace(self):
+        """
+        Record the extraction started from the calling thread when tracing
+        is enabled
+        """
+        set_trace_buffer(self._trace.get())
+
+    cdef void _finish_trace(self) except *:
+        """
+        Stop recording and write all recorded events to the trace file
+        """
+        set_trace_buffer(NULL)
+        if self._trace:
+            self._trace.get().write_chrome_trace(self._trace_file)
+
+    @property
+    def num_threads(self) -> int:
+        """
+        Number of threads used to construct the isosurfaces
+        """
+        set_num_threads(self._num_threads)
+        return get_num_threads()
+
+    @property
+    def parallel_backend(self) -> str:
+        """
+        Backend used for parallelization: :code:`"openmp"` or, when built
+        without OpenMP support, :code:`"threads"`
+        """
+        return get_parallel_backend()
+
+    @property
+    def simd(self) -> str:
+        """
+        Instruction set used to classify the cubes: :code:`"scalar"`,
+        :code:`"sse2"`, :code:`"avx2"` or :code:`"avx512"`; the best one
+        supported by the processor is selected unless the environment
+        variable :code:`PYTESSEL_SIMD` requests another one at import time
+        """
+        return get_classifier_isa()
+
     @cython.embedsignature(True)
     def marching_cubes(
         self,
-        vector[float] grid,
+        grid,
         vector[size_t] dimensions,
         vector[float] unitcell,
-        float isovalue
-    ) -> tuple[
-        npt.NDArray[np.float64],
-        npt.NDArray[np.float64],
-        npt.NDArray[np.float64]
-    ]:
+        float isovalue,
+        str method = "cubes",
+        str normals = "interpolate",
+        bint return_stats = False
+    ) -> tuple:
         """
         Perform marching cubes algorithm to generate isosurface
 
         Parameters
         ----------
-        grid : Iterable of floats
-            Scalar field as a flattened array
+        grid : array_like
+            Scalar field as a (flattened) array; C-contiguous arrays of
+            type float32, float64, (u)int8, (u)int16 and (u)int32 are used
+            without making a copy
         dimensions : Iterable of ints
             Dimensions of the scalar field grid (nx, ny, nz)
         unitcell : Iterable of floats
             Unitcell matrix (flattened)
         isovalue : float
             Isovalue of the isosurface
+        method : str, optional
+            Extraction algorithm: :code:`"cubes"` (default) collects all
+            active cubes before building the triangles, :code:`"streaming"`
+            sweeps over the z-planes of the grid and only keeps the state of
+            two consecutive planes in memory. Both yield the same mesh.
+            :code:`"bricks"` traverses the grid in bricks of 32x32x32 cubes
+            ordered along a Z-order curve and builds the vertices, normals
+            and triangles of every brick in a single task while its grid
+            values reside in cache, after which the bricks are stitched
+            together; it yields the same triangles, but with the vertices
+            and triangles in a different order.
+            :code:`"flying_edges"` uses the flying edges algorithm, which
+            reads every grid value only once and processes the grid row by
+            row; it yields the same triangles, but with the vertices in a
+            different order.
+        normals : str, optional
+            How to calculate the normals at the vertices:
+            :code:`"interpolate"` (default) samples the trilinearly
+            interpolated scalar field around every vertex,
+            :code:`"gradient"` interpolates the central-difference
+            gradients at the grid points of the intersected grid edges while
+            extracting the isosurface (considerably faster) and
+            :code:`"cached"` does the same using a precomputed gradient
+            volume (faster when the scalar field is used for several
+            isovalues, at the expense of storing three floats per grid
+            point while extracting; only a :code:`Tessellator` retains the
+            volume beyond the extraction).
+        return_stats : bool, optional
+            Whether to return the statistics of the construction
                
         Returns
         -------
@@ -49,8 +349,20 @@ cdef class PyTessel:
         normals : (Nx3) numpy array of floats
             Triangle normals (at the vertices)
         indices : numpy array of ints
-            Triangle indices
-        
+            Triangle indices (uint32, or uint64 when the number of
+            vertices exceeds the range of uint32)
+        stats : dict
+            Only returned when :code:`return_stats` is set: the time in
+            seconds spent per phase of the algorithm and of the
+            construction of the mesh (:code:`stats["time"]`, including the
+            :code:`"total"`) and the number of :code:`active_cells`
+            intersected by the isosurface, :code:`triangles`,
+            :code:`unique_vertices`, :code:`vertex_lookups` (searches in the
+            vertex table), :code:`bytes_allocated` (by the buffers of the
+            isosurface and its mesh) and :code:`bytes_retained` (by the
+            returned arrays; all other buffers are released once the mesh
+            has been constructed)
+
         Notes
         -----
         * The scalar field needs to be encoded such that the z-coordinate is the slowest moving
@@ -64,6 +376,7 @@ cdef class PyTessel:
           the triangles are stored as a triplet of indices in the :code:`indices` array. These indices
           refer to the position in the :code:`vertices` and :code:`normals` array. Because multiple
           triangles can use the same vertices, this is an efficient way to store the isosurface.
+        * The arrays share their memory with the constructed mesh; no copies are made.
         * One rarely needs to perform any operations on the :code:`vertices`, :code:`normals` and
           :code:`indices` arrays. Typically, these arrays are constructed and immediately relayed
           to the :code:`write_ply` function to store them as a file which can be used in another
@@ -71,145 +384,834 @@ cdef class PyTessel:
         """
         cdef shared_ptr[ScalarField] scalarfield
         cdef shared_ptr[IsoSurface] isosurface
+        cdef ExtractionMethod engine = _extraction_method(method)
+
+        set_num_threads(self._num_threads)
+
+        # build scalar field
+        grid = _as_grid(grid, dimensions)
+        scalarfield = _scalar_field(grid, dimensions, unitcell)
+
+        # construct isosurface
+        isosurface = make_shared[IsoSurface](scalarfield)
+        isosurface.get().set_compute_normals(_grid_normals(scalarfield, normals))
+        self._start_trace()
+        try:
+            with nogil:
+                isosurface.get().extract(isovalue, engine)
+                scalarfield.get().release_gradients()
+
+            return self._extract_mesh(scalarfield, isosurface, return_stats)
+        finally:
+            self._finish_trace()
+
+    @cython.embedsignature(True)
+    def marching_cubes_async(
+        self,
+        grid,
+        dimensions,
+        unitcell,
+        float isovalue,
+        str method = "cubes",
+        str normals = "interpolate"
+    ) -> Future:
+        """
+        Perform marching cubes algorithm in the background
+
+        Parameters
+        ----------
+        grid : array_like
+            Scalar field as a (flattened) array
+        dimensions : Iterable of ints
+            Dimensions of the scalar field grid (nx, ny, nz)
+        unitcell : Iterable of floats
+            Unitcell matrix (flattened)
+        isovalue : float
+            Isovalue of the isosurface
+        method : str, optional
+            Extraction algorithm (see :code:`marching_cubes`)
+        normals : str, optional
+            How to calculate the normals (see :code:`marching_cubes`)
+
+        Returns
+        -------
+        future : concurrent.futures.Future
+            Future resolving to the vertices, normals and indices as
+            returned by :code:`marching_cubes`
+
+        Notes
+        -----
+        * The isosurfaces are constructed one after the other by a single
+          background thread per :code:`PyTessel` object, each using
+          :code:`num_threads` threads. The interpreter lock is released
+          while the isosurface is constructed, such that the calling thread
+          can, e.g., load the next scalar field in the meantime. The
+          background thread is stopped when the :code:`PyTessel` object is
+          released.
+        * Arrays of a supported data type are used without copying, hence
+          the grid should not be modified until the future has completed.
+        """
+        if self._executor is None:
+            self._executor = ThreadPoolExecutor(max_workers=1, thread_name_prefix="pytessel")
+
+        return self._executor.submit(self.marching_cubes, grid, dimensions, unitcell, isovalue,
+                                     method, normals)
+
+    @cython.embedsignature(True)
+    def marching_cubes_multi(
+        self,
+        grid,
+        vector[size_t] dimensions,
+        vector[float] unitcell,
+        vector[float] isovalues,
+        str normals = "interpolate"
+    ) -> list[tuple[
+        npt.NDArray[np.float64],
+        npt.NDArray[np.float64],
+        npt.NDArray[np.float64]
+    ]]:
+        """
+        Perform marching cubes algorithm for several isovalues at once
+
+        The grid is traversed only once; the rows of every slab of cubes
+        are read once to classify the cubes for all isovalues, after which
+        the vertices and triangles of the slab are emitted per isovalue
+        before moving on to the next slab. This is
+        considerably faster than calling :code:`marching_cubes` for every
+        isovalue, e.g. to construct the positive and negative lobes of a
+        wavefunction or a set of nested density shells.
+
+        Parameters
+        ----------
+        grid : array_like
+            Scalar field as a (flattened) array; C-contiguous arrays of
+            type float32, float64, (u)int8, (u)int16 and (u)int32 are used
+            without making a copy
+        dimensions : Iterable of ints
+            Dimensions of the scalar field grid (nx, ny, nz)
+        unitcell : Iterable of floats
+            Unitcell matrix (flattened)
+        isovalues : Iterable of floats
+            Isovalues of the isosurfaces
+        normals : str, optional
+            How to calculate the normals at the vertices:
+            :code:`"interpolate"` (default) samples the trilinearly
+            interpolated scalar field around every vertex,
+            :code:`"gradient"` interpolates the central-difference
+            gradients at the grid points of the intersected grid edges while
+            extracting the isosurface (considerably faster) and
+            :code:`"cached"` does the same using a precomputed gradient
+            volume (faster when the scalar field is used for several
+            isovalues, at the expense of storing three floats per grid
+            point while extracting; only a :code:`Tessellator` retains the
+            volume beyond the extraction).
+
+        Returns
+        -------
+        meshes : list of tuples
+            For every isovalue (in the same order) a tuple of vertices,
+            normals and indices, identical to the output of
+            :code:`marching_cubes` for that isovalue
+
+        Notes
+        -----
+        * The input is encoded in the same way as for
+          :code:`marching_cubes`.
+        """
+        cdef shared_ptr[ScalarField] scalarfield
+        cdef vector[shared_ptr[IsoSurface]] isosurfaces
+        cdef bint compute_normals
+
+        set_num_threads(self._num_threads)
+
+        # build scalar field
+        grid = _as_grid(grid, dimensions)
+        scalarfield = _scalar_field(grid, dimensions, unitcell)
+
+        # construct isosurfaces
+        compute_normals = _grid_normals(scalarfield, normals)
+        self._start_trace()
+        try:
+            with nogil:
+                isosurfaces = IsoSurface.marching_cubes_multi(scalarfield, isovalues, compute_normals)
+                scalarfield.get().release_gradients()
+
+            return [self._extract_mesh(scalarfield, isosurface) for isosurface in isosurfaces]
+        finally:
+            self._finish_trace()
+
+    @cython.embedsignature(True)
+    def marching_cubes_batch(
+        self,
+        grids,
+        unitcells,
+        isovalues,
+        str method = "cubes",
+        str normals = "interpolate"
+    ) -> tuple[
+        npt.NDArray[np.float32],
+        npt.NDArray[np.float32],
+        npt.NDArray[np.uint32],
+        npt.NDArray[np.int64],
+        npt.NDArray[np.int64]
+    ]:
+        """
+        Perform marching cubes algorithm for a batch of scalar fields
+
+        Intended for large numbers of small scalar fields (e.g. the orbitals
+        of a molecule or the frames of a trajectory), for which parallelizing
+        the construction of a single isosurface does not pay off: the fields
+        are distributed over the threads, every field being processed by a
+        single thread, and all isosurfaces are returned as one concatenated
+        mesh.
+
+        Parameters
+        ----------
+        grids : array_like or list of array_like
+            Scalar fields as a stacked 4D array of shape (n, nz, ny, nx) or
+            as a list of 3D arrays of shape (nz, ny, nx); the dimensions of
+            every field are taken from its shape
+        unitcells : array_like
+            Unitcell matrix shared by all fields, shape (3, 3), or one
+            unitcell matrix per field, shape (n, 3, 3)
+        isovalues : float or array_like
+            Isovalue shared by all fields or one isovalue per field
+        method : str, optional
+            Extraction algorithm (see :code:`marching_cubes`)
+        normals : str, optional
+            How to calculate the normals (see :code:`marching_cubes`)
+
+        Returns
+        -------
+        vertices : (Nx3) numpy array of floats
+            Vertices of all isosurfaces
+        normals : (Nx3) numpy array of floats
+            Normals of all isosurfaces (at the vertices)
+        indices : numpy array of ints
+            Triangle indices of all isosurfaces; the indices of every
+            isosurface refer to its own vertices
+        vertex_offsets : (n+1) numpy array of ints
+            The vertices of field :code:`i` are
+            :code:`vertices[vertex_offsets[i]:vertex_offsets[i+1]]`
+        index_offsets : (n+1) numpy array of ints
+            The triangle indices of field :code:`i` are
+            :code:`indices[index_offsets[i]:index_offsets[i+1]]`
+
+        Notes
+        -----
+        * The isosurface of every field is identical to the output of
+          :code:`marching_cubes` for that field.
+        """
+        cdef vector[shared_ptr[ScalarField]] scalarfields
+        cdef vector[float] isovalues_c
+        cdef vector[size_t] vertex_offsets
+        cdef vector[size_t] index_offsets
         cdef shared_ptr[IsoSurfaceMesh] isosurface_mesh
+        cdef ExtractionMethod engine = _extraction_method(method)
+        cdef bint compute_normals = normals != "interpolate"
+        cdef bint cache_gradients = normals == "cached"
+
+        if normals not in ("gradient", "cached", "interpolate"):
+            raise ValueError("Unknown normals: %s" % normals)
+
+        if isinstance(grids, np.ndarray) and grids.ndim == 4:
+            grids = list(grids)
+        grids = [np.asarray(grid) for grid in grids]
+        nfields = len(grids)
+        if any(grid.ndim != 3 for grid in grids):
+            raise ValueError("Scalar fields should be three-dimensional arrays")
+
+        unitcells = np.asarray(unitcells, dtype=np.float32)
+        if unitcells.shape == (3, 3):
+            unitcells = np.broadcast_to(unitcells, (nfields, 3, 3))
+        if unitcells.shape != (nfields, 3, 3):
+            raise ValueError("Shape of the unitcells %s does not match the number of scalar fields (%i)" %
+                             (unitcells.shape, nfields))
+
+        isovalues = np.broadcast_to(np.asarray(isovalues, dtype=np.float32), (nfields,))
+        isovalues_c = isovalues
+
+        set_num_threads(self._num_threads)
+
+        # build the scalar fields; the flat arrays are kept alive until the
+        # isosurfaces have been constructed
+        flatgrids = []
+        for grid, unitcell in zip(grids, unitcells):
+            dimensions = list(reversed(grid.shape))
+            flatgrids.append(_as_grid(grid, dimensions))
+            scalarfields.push_back(_scalar_field(flatgrids[-1], dimensions, unitcell.reshape(-1)))
+
+        self._start_trace()
+        try:
+            with nogil:
+                isosurface_mesh = marching_cubes_batch(scalarfields, isovalues_c, engine, compute_normals,
+                                                       cache_gradients, vertex_offsets, index_offsets)
+        finally:
+            self._finish_trace()
+
+        vertices, vertex_normals, indices = _mesh_arrays(isosurface_mesh)
+
+        return (vertices, vertex_normals, indices,
+                np.asarray(vertex_offsets, dtype=np.int64), np.asarray(index_offsets, dtype=np.int64))
+
+    @cython.embedsignature(True)
+    def marching_cubes_file(
+        self,
+        filename,
+        vector[float] unitcell,
+        float isovalue,
+        dimensions = None,
+        str dtype = None,
+        size_t offset = 0,
+        size_t memory_budget = 1 << 30,
+        str normals = "gradient",
+        bint return_stats = False
+    ) -> tuple:
+        """
+        Perform marching cubes algorithm on a scalar field stored in a file
+        without loading it into memory
+
+        The file is memory-mapped and the grid is swept in tiles of z-planes
+        (see the :code:`"streaming"` method of :code:`marching_cubes`): the
+        planes of the next tile are read ahead while a tile is processed
+        and the planes behind the sweep are released, such that the part of
+        the grid resident in memory is bounded by :code:`memory_budget`.
+        This allows constructing isosurfaces of scalar fields which do not
+        fit in memory.
+
+        Parameters
+        ----------
+        filename : str or path-like
+            Path to a NumPy (.npy) file holding a three-dimensional array of
+            shape (nz, ny, nx) in C order, or to a raw file of grid values
+            (x fastest moving) when :code:`dimensions` and :code:`dtype`
+            are given
+        unitcell : Iterable of floats
+            Unitcell matrix (flattened)
+        isovalue : float
+            Isovalue of the isosurface
+        dimensions : Iterable of ints, optional
+            Dimensions of the scalar field grid (nx, ny, nz) of a raw file
+        dtype : str, optional
+            Data type of the grid values of a raw file in native byte
+            order, e.g. :code:`"f4"`, :code:`"f8"`, :code:`"i2"` or
+            :code:`"u1"`
+        offset : int, optional
+            Offset of the grid values in a raw file in bytes
+        memory_budget : int, optional
+            Maximum number of bytes of the grid resident in memory at once
+            (default: 1 GiB); the mesh itself is not included
+        normals : str, optional
+            :code:`"gradient"` (default) or :code:`"interpolate"` (see
+            :code:`marching_cubes`); the latter samples the grid around
+            every vertex after the sweep, which is not bounded by the
+            memory budget
+        return_stats : bool, optional
+            Whether to return the statistics of the construction
+
+        Returns
+        -------
+        vertices, normals, indices[, stats]
+            As returned by :code:`marching_cubes`; the isosurface is
+            identical to the one constructed by :code:`marching_cubes`
+            using the :code:`"streaming"` method
+
+        Notes
+        -----
+        * Releasing the pages behind the sweep is not supported on Windows,
+          where paging is left to the operating system.
+        """
+        cdef shared_ptr[MappedFile] mapping
+        cdef shared_ptr[ScalarField] scalarfield
+        cdef shared_ptr[IsoSurface] isosurface
+        cdef string dtype_c
+        cdef vector[size_t] dimensions_c
+        cdef size_t data_offset = offset
+
+        if normals not in ("gradient", "interpolate"):
+            raise ValueError("Unsupported normals for a scalar field in a file: %s" % normals)
+
+        mapping = make_shared[MappedFile](<string>os.fspath(filename))
+        if dimensions is None and dtype is None:
+            data_offset = read_npy_header(mapping.get()[0], dtype_c, dimensions_c)
+        elif dimensions is None or dtype is None:
+            raise ValueError("Both the dimensions and the data type of a raw file should be given")
+        else:
+            dimensions_c = dimensions
+            dtype_c = dtype
+
+        if dimensions_c.size() != 3 or any(d < 2 for d in dimensions_c):
+            raise ValueError("Invalid dimensions of the scalar field: %s" % (tuple(dimensions_c),))
+
+        set_num_threads(self._num_threads)
+        scalarfield = make_shared[ScalarField](mapping, data_offset, dtype_c, dimensions_c, unitcell)
+
+        # construct isosurface
+        isosurface = make_shared[IsoSurface](scalarfield)
+        isosurface.get().set_compute_normals(normals == "gradient")
+        self._start_trace()
+        try:
+            with nogil:
+                isosurface.get().marching_cubes_tiled(isovalue, memory_budget)
+
+            return self._extract_mesh(scalarfield, isosurface, return_stats)
+        finally:
+            self._finish_trace()
+
+    @cython.embedsignature(True)
+    def marching_cubes_to_stl(
+        self,
+        grid,
+        vector[size_t] dimensions,
+        vector[float] unitcell,
+        float isovalue,
+        filename,
+        bint binary = True
+    ) -> int:
+        """
+        Perform marching cubes algorithm and write the isosurface directly
+        to an STL file
+
+        An STL file is a list of separate triangles; rather than building
+        the mesh (see :code:`marching_cubes`) and expanding it again in
+        :code:`write_stl`, the triangles of every slab of cubes are written
+        to the file as soon as they are constructed. Neither the table of
+        shared vertices, nor the normals at the vertices, nor the mesh are
+        built, such that this uses only a fraction of the time and memory.
+        The facets are the same (oriented) triangles as those of the mesh
+        of :code:`marching_cubes` using :code:`normals="gradient"`; the
+        normal of every facet is calculated from the gradient of the grid
+        at the centroid of the triangle.
+
+        Parameters
+        ----------
+        grid : array_like
+            Scalar field as a (flattened) array (see :code:`marching_cubes`)
+        dimensions : Iterable of ints
+            Dimensions of the scalar field grid (nx, ny, nz)
+        unitcell : Iterable of floats
+            Unitcell matrix (flattened)
+        isovalue : float
+            Isovalue of the isosurface
+        filename : str or path-like
+            Path to the STL file
+        binary : bool, optional
+            Whether to write a binary (default) or an ASCII STL file
+
+        Returns
+        -------
+        int
+            Number of triangles written
+        """
+        cdef shared_ptr[ScalarField] scalarfield
+        cdef string filename_c = os.fspath(filename)
+        cdef size_t nrtriangles
+
+        set_num_threads(self._num_threads)
 
         # build scalar field
-        scalarfield = make_shared[ScalarField](grid, dimensions, unitcell)
+        grid = _as_grid(grid, dimensions)
+        scalarfield = _scalar_field(grid, dimensions, unitcell)
+
+        self._start_trace()
+        try:
+            with nogil:
+                nrtriangles = cpp_marching_cubes_to_stl(scalarfield, isovalue, filename_c, binary)
+
+            return nrtriangles
+        finally:
+            self._finish_trace()
+
+    @cython.embedsignature(True)
+    def marching_tetrahedra(
+        self,
+        grid,
+        vector[size_t] dimensions,
+        vector[float] unitcell,
+        float isovalue,
+        str normals = "interpolate",
+        bint return_stats = False
+    ) -> tuple:
+        """
+        Perform marching tetrahedra algorithm to generate isosurface
+
+        Every cube of the grid is split into six tetrahedra. In contrast to
+        marching cubes, this algorithm does not suffer from topological
+        ambiguities at the expense of generating more triangles.
+
+        Parameters
+        ----------
+        grid : array_like
+            Scalar field as a (flattened) array; C-contiguous arrays of
+            type float32, float64, (u)int8, (u)int16 and (u)int32 are used
+            without making a copy
+        dimensions : Iterable of ints
+            Dimensions of the scalar field grid (nx, ny, nz)
+        unitcell : Iterable of floats
+            Unitcell matrix (flattened)
+        isovalue : float
+            Isovalue of the isosurface
+        normals : str, optional
+            How to calculate the normals at the vertices:
+            :code:`"interpolate"` (default) samples the trilinearly
+            interpolated scalar field around every vertex,
+            :code:`"gradient"` interpolates the central-difference
+            gradients at the grid points of the intersected grid edges while
+            extracting the isosurface (considerably faster) and
+            :code:`"cached"` does the same using a precomputed gradient
+            volume (faster when the scalar field is used for several
+            isovalues, at the expense of storing three floats per grid
+            point while extracting; only a :code:`Tessellator` retains the
+            volume beyond the extraction).
+        return_stats : bool, optional
+            Whether to return the statistics of the construction
+
+        Returns
+        -------
+        vertices : (Nx3) numpy array of floats
+            Triangle vertices
+        normals : (Nx3) numpy array of floats
+            Triangle normals (at the vertices)
+        indices : numpy array of ints
+            Triangle indices (uint32, or uint64 when the number of
+            vertices exceeds the range of uint32)
+        stats : dict
+            Only returned when :code:`return_stats` is set (see
+            :code:`marching_cubes`)
+
+        Notes
+        -----
+        * The input and output are encoded in the same way as for
+          :code:`marching_cubes`.
+        """
+        cdef shared_ptr[ScalarField] scalarfield
+        cdef shared_ptr[IsoSurface] isosurface
+
+        set_num_threads(self._num_threads)
+
+        # build scalar field
+        grid = _as_grid(grid, dimensions)
+        scalarfield = _scalar_field(grid, dimensions, unitcell)
 
         # construct isosurface
         isosurface = make_shared[IsoSurface](scalarfield)
-        isosurface.get().marching_cubes(isovalue)
+        isosurface.get().set_compute_normals(_grid_normals(scalarfield, normals))
+        self._start_trace()
+        try:
+            with nogil:
+                isosurface.get().marching_tetrahedra(isovalue)
+                scalarfield.get().release_gradients()
+
+            return self._extract_mesh(scalarfield, isosurface, return_stats)
+        finally:
+            self._finish_trace()
+
+    cdef tuple _extract_mesh(self, shared_ptr[ScalarField] scalarfield, shared_ptr[IsoSurface] isosurface,
+                             bint return_stats = False):
+        """
+        Build the mesh (including normals) of a constructed isosurface and
+        return its vertices, normals and indices, followed by the statistics
+        of the construction when requested
+        """
+        cdef shared_ptr[IsoSurfaceMesh] isosurface_mesh
 
         # extract isosurface mesh
         isosurface_mesh = make_shared[IsoSurfaceMesh](scalarfield, isosurface)
-        isosurface_mesh.get().construct_mesh(False)
+        with nogil:
+            isosurface_mesh.get().construct_mesh(False)
 
-        # extract data
-        vertices = np.array(isosurface_mesh.get().get_vertices(), dtype=np.float32).reshape(-1,3)
-        normals = np.array(isosurface_mesh.get().get_normals(), dtype=np.float32).reshape(-1,3)
-        indices = np.array(isosurface_mesh.get().get_indices(), dtype=np.uint32)
+        if return_stats:
+            return _mesh_arrays(isosurface_mesh) + (_stats_dict(isosurface, isosurface_mesh),)
 
-        return vertices, normals, indices
+        return _mesh_arrays(isosurface_mesh)
 
-    def write_ply(self,
-        filename: str,
-        vertices: npt.NDArray[np.float64],
-        normals: npt.NDArray[np.float64],
-        indices: npt.NDArray[np.uint32],
-    ) -> None:
+    @cython.embedsignature(True)
+    def read_cube(self, filename) -> tuple[npt.NDArray[np.float32], npt.NDArray[np.float32]]:
         """
-        Write a binary PLY file with vertices, normals, and triangular faces.
+        Read a scalar field from a Gaussian CUBE file
+
+        Parameters
+        ----------
+        filename : str or path-like
+            Path to the file
+
+        Returns
+        -------
+        grid : (nz, ny, nx) numpy array of floats
+            Scalar field, which can be passed directly to
+            :code:`marching_cubes` using :code:`reversed(grid.shape)` as
+            the dimensions
+        unitcell : (3x3) numpy array of floats
+            Unitcell matrix (the grid vectors times the number of grid
+            points along each axis) in the units of the file (Bohr, or
+            Angstrom when the numbers of grid points are negative)
+
+        Notes
+        -----
+        * The grid values are parsed in parallel using :code:`num_threads`
+          threads.
+        * The origin of the grid is not used. For files holding several
+          orbitals, only the first orbital is read.
         """
+        cdef shared_ptr[ScalarField] scalarfield
+        cdef string filename_c = os.fspath(filename)
 
-        if vertices.shape != normals.shape:
-            raise ValueError("vertices and normals must have the same shape")
+        set_num_threads(self._num_threads)
+        with nogil:
+            scalarfield = cpp_read_cube(filename_c)
 
-        if vertices.shape[1] != 3:
-            raise ValueError("vertices must be of shape (N, 3)")
+        return _field_arrays(scalarfield)
 
-        if indices.ndim != 1 or len(indices) % 3 != 0:
-            raise ValueError("indices must be a flat array of length multiple of 3")
+    @cython.embedsignature(True)
+    def read_chgcar(self, filename, bint locpot = False) -> tuple[npt.NDArray[np.float32],
+                                                                   npt.NDArray[np.float32]]:
+        """
+        Read a scalar field from a VASP CHGCAR, PARCHG or LOCPOT file
+
+        Parameters
+        ----------
+        filename : str or path-like
+            Path to the file
+        locpot : bool, optional
+            Whether the file is a LOCPOT file; the values of CHGCAR and
+            PARCHG files (the density times the volume of the unitcell) are
+            divided by the volume of the unitcell, whereas those of LOCPOT
+            files are used as is
+
+        Returns
+        -------
+        grid : (nz, ny, nx) numpy array of floats
+            Scalar field, which can be passed directly to
+            :code:`marching_cubes` using :code:`reversed(grid.shape)` as
+            the dimensions
+        unitcell : (3x3) numpy array of floats
+            Unitcell matrix (lattice vectors) in Angstrom
+
+        Notes
+        -----
+        * The grid values are parsed in parallel using :code:`num_threads`
+          threads.
+        * Only the first block of grid values is read, i.e. the total
+          density of spin-polarized calculations.
+        """
+        cdef shared_ptr[ScalarField] scalarfield
+        cdef string filename_c = os.fspath(filename)
+
+        set_num_threads(self._num_threads)
+        with nogil:
+            scalarfield = cpp_read_chgcar(filename_c, locpot)
+
+        return _field_arrays(scalarfield)
+
+    @cython.embedsignature(True)
+    def write_ply(self,
+        filename,
+        vertices: npt.NDArray[np.float32],
+        normals: npt.NDArray[np.float32],
+        indices: npt.NDArray[np.uint32],
+        bint binary = True,
+    ) -> None:
+        """
+        Write a PLY file with vertices, normals, and triangular faces
 
-        n_vertices = vertices.shape[0]
-        n_faces = len(indices) // 3
-
-        endian = "binary_little_endian" if sys.byteorder == "little" else "binary_big_endian"
-
-        header = (
-            "ply\n"
-            f"format {endian} 1.0\n"
-            "comment generated by write_ply\n"
-            f"element vertex {n_vertices}\n"
-            "property float x\n"
-            "property float y\n"
-            "property float z\n"
-            "property float nx\n"
-            "property float ny\n"
-            "property float nz\n"
-            f"element face {n_faces}\n"
-            "property list uchar uint vertex_indices\n"
-            "end_header\n"
-        ).encode("ascii")
-
-        # Interleave vertices and normals: (N, 6)
-        vertex_data = np.hstack((vertices, normals)).astype(np.float32, copy=False)
-
-        # Face data: [3, i0, i1, i2]
-        face_data = np.empty((n_faces, 4), dtype=np.uint32)
-        face_data[:, 0] = 3
-        face_data[:, 1:] = indices.reshape(-1, 3)
-
-        # The first element must be uint8, the rest uint32
-        face_bytes = np.empty(
-            n_faces,
-            dtype=[("n", "u1"), ("i", "u4", (3,))]
-        )
-        face_bytes["n"] = 3
-        face_bytes["i"] = indices.reshape(-1, 3)
-
-        with open(filename, "wb") as f:
-            f.write(header)
-            f.write(vertex_data.tobytes())
-            f.write(face_bytes.tobytes())
+        Parameters
+        ----------
+        filename : str or path-like
+            Path to the file
+        vertices : (N, 3) array of vertex positions
+        normals : (N, 3) array of vertex normals
+        indices : (M,) flat array of triangle indices, length multiple of 3
+        binary : bool, optional
+            Whether to write a binary (little endian) file (default) or an
+            ASCII file
+
+        Notes
+        -----
+        * The file is written directly from the arrays, in parallel blocks
+          using :code:`num_threads` threads; the arrays returned by
+          :code:`marching_cubes` are not copied.
+        """
+        self._write_mesh(filename, vertices, normals, indices, binary, False)
 
+    @cython.embedsignature(True)
     def write_stl(self,
-        filename: str,
-        vertices: npt.NDArray[np.float64],
-        normals: npt.NDArray[np.float64],
+        filename,
+        vertices: npt.NDArray[np.float32],
+        normals: npt.NDArray[np.float32],
         indices: npt.NDArray[np.uint32],
+        bint binary = True,
     ) -> None:
         """
-        Write a binary STL file.
+        Write an STL file
 
         Parameters
         ----------
+        filename : str or path-like
+            Path to the file
         vertices : (N, 3) array of vertex positions
-        indices  : (M,) flat array, length multiple of 3
-        normals  : (N, 3) vertex normals
+        normals : (N, 3) array of vertex normals; the normal of every
+            triangle is the normalized sum of the normals at its vertices
+        indices : (M,) flat array of triangle indices, length multiple of 3
+        binary : bool, optional
+            Whether to write a binary file (default) or an ASCII file
+
+        Notes
+        -----
+        * The file is written directly from the arrays, in parallel blocks
+          using :code:`num_threads` threads; the arrays returned by
+          :code:`marching_cubes` are not copied.
+        """
+        self._write_mesh(filename, vertices, normals, indices, binary, True)
+
+    cdef void _write_mesh(self, filename, vertices, normals, indices, bint binary, bint stl) except *:
         """
+        Write a mesh as a PLY or STL file
+        """
+        cdef shared_ptr[MeshBuffers] buffers
+        cdef string filename_c = os.fspath(filename)
+        cdef size_t nr_vertices, nr_indices, index_size
+
+        vertices = np.ascontiguousarray(vertices, dtype=np.float32)
+        normals = np.ascontiguousarray(normals, dtype=np.float32)
+        indices = np.asarray(indices)
 
         if vertices.shape != normals.shape:
             raise ValueError("vertices and normals must have the same shape")
 
-        if vertices.shape[1] != 3:
+        if vertices.ndim != 2 or vertices.shape[1] != 3:
             raise ValueError("vertices must be of shape (N, 3)")
 
         if indices.ndim != 1 or len(indices) % 3 != 0:
-            raise ValueError("indices must be a flat array with length multiple of 3")
+            raise ValueError("indices must be a flat array of length multiple of 3")
+
+        # integer indices are used without copying (negative indices are
+        # rejected as being out of range)
+        if indices.dtype.kind in 'iu' and indices.dtype.itemsize in (4, 8) and indices.dtype.isnative:
+            indices = np.ascontiguousarray(indices).view('u%i' % indices.dtype.itemsize)
+        else:
+            indices = np.ascontiguousarray(indices, dtype=np.uint32)
+
+        nr_vertices = len(vertices)
+        nr_indices = len(indices)
+        index_size = indices.dtype.itemsize
+        buffers = make_shared[MeshBuffers](<const float*>_array_data(vertices), <const float*>_array_data(normals),
+                                           nr_vertices, _array_data(indices), nr_indices, index_size)
+
+        set_num_threads(self._num_threads)
+        with nogil:
+            if stl:
+                cpp_write_stl(filename_c, buffers.get()[0], binary)
+            else:
+                cpp_write_ply(filename_c, buffers.get()[0], binary)
+
+cdef class Tessellator:
+    """
+    Extraction session for a single scalar field
+
+    Intended for the interactive exploration of isovalues: the scalar field,
+    its acceleration data (the minimum and maximum value per brick of cubes
+    and, optionally, the gradient volume) and all scratch space of the
+    extraction algorithm are retained between the calls to :code:`extract`.
+    When the arrays returned by the previous call are no longer referenced,
+    their memory is reused as well, such that repeated extractions do not
+    perform any large allocations.
+
+    Parameters
+    ----------
+    grid : array_like
+        Scalar field as a 3D array of shape (nz, ny, nx) or as a flattened
+        array together with :code:`dimensions`; C-contiguous arrays of type
+        float32, float64, (u)int8, (u)int16 and (u)int32 are used without
+        making a copy
+    unitcell : array_like
+        Unitcell matrix, shape (3, 3) or flattened
+    dimensions : Iterable of ints, optional
+        Dimensions of the scalar field grid (nx, ny, nz); by default taken
+        from the shape of the grid
+    method : str, optional
+        Extraction algorithm (see :code:`PyTessel.marching_cubes`)
+    normals : str, optional
+        How to calculate the normals (see :code:`PyTessel.marching_cubes`)
+    num_threads : int, optional
+        Number of threads used to construct the isosurfaces (see
+        :code:`PyTessel`)
+
+    Notes
+    -----
+    * The grid is referenced rather than copied whenever possible and
+      should hence not be modified during the lifetime of the session.
+    """
+    cdef shared_ptr[CppTessellator] _tessellator
+    cdef size_t _num_threads
+    cdef object _grid
+    cdef object _lock
+
+    def __cinit__(self, grid, unitcell, dimensions = None, str method = "cubes", str normals = "interpolate",
+                  num_threads = None):
+        cdef shared_ptr[ScalarField] scalarfield
+        cdef ExtractionMethod engine = _extraction_method(method)
+        cdef bint compute_normals = normals != "interpolate"
+        cdef bint cache_gradients = normals == "cached"
 
-        # Build triangle vertices: (T, 3, 3)
-        triangles = vertices[indices].reshape(-1, 3, 3)
+        if normals not in ("gradient", "cached", "interpolate"):
+            raise ValueError("Unknown normals: %s" % normals)
+        if num_threads is not None and num_threads < 1:
+            raise ValueError("Number of threads should be at least one: %s" % num_threads)
+        self._num_threads = 0 if num_threads is None else num_threads
 
-        # Compute face normals from vertex normals
-        tri_normals = normals[indices].reshape(-1, 3, 3)
-        face_normals = tri_normals.sum(axis=1)
+        grid = np.asarray(grid)
+        if dimensions is None:
+            dimensions = list(reversed(grid.shape))
 
-        # Normalize
-        norm = np.linalg.norm(face_normals, axis=1)
-        norm[norm == 0.0] = 1.0
-        face_normals /= norm[:, None]
+        set_num_threads(self._num_threads)
 
-        n_triangles = triangles.shape[0]
+        self._grid = _as_grid(grid, dimensions)
+        self._lock = threading.Lock()
+        scalarfield = _scalar_field(self._grid, dimensions, np.asarray(unitcell, dtype=np.float32).reshape(-1))
+        with nogil:
+            self._tessellator = make_shared[CppTessellator](scalarfield, engine, compute_normals, cache_gradients)
 
-        header = b"Generated by write_stl".ljust(80, b"\0")
+    @cython.embedsignature(True)
+    def extract(
+        self,
+        float isovalue,
+        bint return_stats = False
+    ) -> tuple:
+        """
+        Construct the isosurface for an isovalue
+
+        Parameters
+        ----------
+        isovalue : float
+            Isovalue of the isosurface
+        return_stats : bool, optional
+            Whether to return the statistics of the construction
 
-        with open(filename, "wb") as f:
-            f.write(header)
-            f.write(np.uint32(n_triangles).tobytes())
+        Returns
+        -------
+        vertices : (Nx3) numpy array of floats
+            Triangle vertices
+        normals : (Nx3) numpy array of floats
+            Triangle normals (at the vertices)
+        indices : numpy array of ints
+            Triangle indices
+        stats : dict
+            Only returned when :code:`return_stats` is set (see
+            :code:`PyTessel.marching_cubes`); :code:`bytes_allocated`
+            includes the scratch space retained by the session
 
-            dtype = np.dtype([
-                ("normal", "f4", (3,)),
-                ("v1", "f4", (3,)),
-                ("v2", "f4", (3,)),
-                ("v3", "f4", (3,)),
-                ("attr", "u2"),
-            ])
+        Notes
+        -----
+        * The output is identical to that of :code:`PyTessel.marching_cubes`.
+        """
+        cdef shared_ptr[IsoSurfaceMesh] isosurface_mesh
 
-            data = np.empty(n_triangles, dtype=dtype)
-            data["normal"] = face_normals.astype(np.float32)
-            data["v1"] = triangles[:, 0].astype(np.float32)
-            data["v2"] = triangles[:, 1].astype(np.float32)
-            data["v3"] = triangles[:, 2].astype(np.float32)
-            data["attr"] = 0
+        with self._lock:
+            set_num_threads(self._num_threads)
+            with nogil:
+                isosurface_mesh = self._tessellator.get().extract(isovalue)
 
-            f.write(data.tobytes())
+            if return_stats:
+                return _mesh_arrays(isosurface_mesh) + \
+                       (_stats_dict(self._tessellator.get().get_isosurface(), isosurface_mesh),)
+            return _mesh_arrays(isosurface_mesh)
@@ -19,19 +19,28 @@
  **************************************************************************/
 
 #include "scalar_field.h"
+#include "parallel.h"
 
 /**
- * @brief      constructor
+ * @brief      constructor taking ownership of the grid values
  *
- * @param[in]  _filename   url to filename
- * @param[in]  _flag_is_locpot  whether this file is a locpot
+ * @param[in]  _grid        grid values (x fastest moving)
+ * @param[in]  _dimensions  grid dimensions (nx, ny, nz)
+ * @param[in]  _unitcell    unitcell matrix (flattened)
  */
-ScalarField::ScalarField(const std::vector<float>& _grid,
+ScalarField::ScalarField(std::vector<float> _grid,
                          const std::vector<size_t>& _dimensions,
-                         const std::vector<float>& _unitcell) {
+                         const std::vector<float>& _unitcell) :
+    grid(std::move(_grid)),
+    data(grid.data()),
+    dtype(ScalarType::FLOAT32),
+    bricks_built(false),
+    gradients_built(false) {
 
-    this->grid = _grid;
     this->grid_dimensions = {_dimensions[0], _dimensions[1], _dimensions[2]};
+    for(size_t i=0; i<3; i++) {
+        this->brick_dimensions[i] = std::max<size_t>(1, (this->grid_dimensions[i] + BRICK_SIZE - 2) / BRICK_SIZE);
+    }
     for(size_t i=0; i<3; i++) {
         for(size_t j=0; j<3; j++) {
             this->unitcell[i][j] = _unitcell[i*3 + j];
@@ -40,6 +49,105 @@ ScalarField::ScalarField(const std::vector<float>& _grid,
     this->inverse(this->unitcell, &this->unitcell_inverse);
 }
 
+/**
+ * @brief      constructor referencing an external buffer without copying
+ *
+ * @param[in]  _data        pointer to the grid values (x fastest moving)
+ * @param[in]  _dtype       element type as typecode and number of bytes
+ * @param[in]  _dimensions  grid dimensions (nx, ny, nz)
+ * @param[in]  _unitcell    unitcell matrix (flattened)
+ */
+ScalarField::ScalarField(const void* _data,
+                         const std::string& _dtype,
+                         const std::vector<size_t>& _dimensions,
+                         const std::vector<float>& _unitcell) :
+    data(_data),
+    bricks_built(false),
+    gradients_built(false) {
+
+    static const std::pair<const char*, ScalarType> dtypes[] = {
+        {"f4", ScalarType::FLOAT32}, {"f8", ScalarType::FLOAT64},
+        {"i1", ScalarType::INT8},    {"u1", ScalarType::UINT8},
+        {"i2", ScalarType::INT16},   {"u2", ScalarType::UINT16},
+        {"i4", ScalarType::INT32},   {"u4", ScalarType::UINT32}
+    };
+    auto it = std::find_if(std::begin(dtypes), std::end(dtypes), [&_dtype](const auto& d) {
+        return _dtype == d.first;
+    });
+    if(it == std::end(dtypes)) {
+        throw std::invalid_argument("Unsupported data type of scalar field: " + _dtype);
+    }
+    this->dtype = it->second;
+
+    this->grid_dimensions = {_dimensions[0], _dimensions[1], _dimensions[2]};
+    for(size_t i=0; i<3; i++) {
+        this->brick_dimensions[i] = std::max<size_t>(1, (this->grid_dimensions[i] + BRICK_SIZE - 2) / BRICK_SIZE);
+    }
+    for(size_t i=0; i<3; i++) {
+        for(size_t j=0; j<3; j++) {
+            this->unitcell[i][j] = _unitcell[i*3 + j];
+        }
+    }
+    this->inverse(this->unitcell, &this->unitcell_inverse);
+}
+
+/**
+ * @brief      constructor referencing the grid values in a memory-mapped file
+ *
+ * @param[in]  _mapping     the mapped file
+ * @param[in]  _offset      offset of the grid values in bytes
+ * @param[in]  _dtype       element type as typecode and number of bytes
+ * @param[in]  _dimensions  grid dimensions (nx, ny, nz)
+ * @param[in]  _unitcell    unitcell matrix (flattened)
+ */
+ScalarField::ScalarField(const std::shared_ptr<MappedFile>& _mapping,
+                         size_t _offset,
+                         const std::string& _dtype,
+                         const std::vector<size_t>& _dimensions,
+                         const std::vector<float>& _unitcell) :
+    ScalarField(_mapping->get_data() + _offset, _dtype, _dimensions, _unitcell) {
+
+    const size_t itemsize = this->visit([](const auto* values) { return sizeof(*values); });
+    if(_offset % itemsize != 0) {
+        throw std::invalid_argument("Offset of the scalar field is not a multiple of its element size");
+    }
+    if(_dimensions[0] == 0 || _dimensions[1] == 0 || _offset > _mapping->get_size() ||
+       (_mapping->get_size() - _offset) / itemsize / _dimensions[0] / _dimensions[1] < _dimensions[2]) {
+        throw std::invalid_argument("File is too small to hold a scalar field of the given dimensions");
+    }
+    this->mapping = _mapping;
+}
+
+/**
+ * @brief      hint that the grid planes [z0, z1) are about to be read
+ *
+ * @param[in]  z0    first plane
+ * @param[in]  z1    one past the last plane
+ */
+void ScalarField::prefetch_planes(size_t z0, size_t z1) const {
+    z1 = std::min(z1, this->grid_dimensions[2]);
+    if(!this->mapping || z0 >= z1) {
+        return;
+    }
+    const size_t offset = static_cast<const char*>(this->data) - this->mapping->get_data();
+    this->mapping->will_need(offset + z0 * this->get_plane_bytes(), (z1 - z0) * this->get_plane_bytes());
+}
+
+/**
+ * @brief      hint that the grid planes [z0, z1) are no longer needed
+ *
+ * @param[in]  z0    first plane
+ * @param[in]  z1    one past the last plane
+ */
+void ScalarField::release_planes(size_t z0, size_t z1) const {
+    z1 = std::min(z1, this->grid_dimensions[2]);
+    if(!this->mapping || z0 >= z1) {
+        return;
+    }
+    const size_t offset = static_cast<const char*>(this->data) - this->mapping->get_data();
+    this->mapping->dont_need(offset + z0 * this->get_plane_bytes(), (z1 - z0) * this->get_plane_bytes());
+}
+
 /*
  * float get_value_interp(x,y,z)
  *
@@ -118,21 +226,6 @@ bool ScalarField::is_inside(float x, float y, float z) const {
     return true;
 }
 
-/*
- * float get_value(i,j,k)
- *
- * Grabs the value at a particular grid point.
- *
- * This is a convenience function for the get_value_interp() function
- *
- */
-float ScalarField::get_value(size_t i, size_t j, size_t k) const {
-    size_t idx = k * this->grid_dimensions[0] * this->grid_dimensions[1] +
-                       j * this->grid_dimensions[0] +
-                       i;
-    return this->grid[idx];
-}
-
 /*
  * Vec3 grid_to_realspace(i,j,k)
  *
@@ -188,11 +281,238 @@ void ScalarField::copy_grid_dimensions(size_t _grid_dimensions[]) const {
 }
 
 float ScalarField::get_max() const {
-    return *std::max_element(this->grid.begin(), this->grid.end());
+    this->build_bricks();
+    return *std::max_element(this->brick_max.begin(), this->brick_max.end());
 }
 
 float ScalarField::get_min() const {
-    return *std::min_element(this->grid.begin(), this->grid.end());
+    this->build_bricks();
+    return *std::min_element(this->brick_min.begin(), this->brick_min.end());
+}
+
+/**
+ * @brief      build the table holding the minimum and maximum value of
+ *             every brick of BRICK_SIZE^3 cubes
+ *
+ * Brick b along an axis covers the cubes [b*BRICK_SIZE, (b+1)*BRICK_SIZE)
+ * and hence the grid points [b*BRICK_SIZE, (b+1)*BRICK_SIZE]. Grid points on
+ * the faces between bricks are thus shared between neighbouring bricks.
+ *
+ * @param[in]  _max_planes  for memory-mapped grids: maximum number of grid
+ *                          planes resident at once (0: no limit)
+ */
+void ScalarField::build_bricks(size_t _max_planes) const {
+    if(this->bricks_built.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(this->bricks_mutex);
+    if(this->bricks_built.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    const size_t nbx = this->brick_dimensions[0];
+    const size_t nby = this->brick_dimensions[1];
+    const size_t nbz = this->brick_dimensions[2];
+    this->brick_min.resize(nbx * nby * nbz);
+    this->brick_max.resize(nbx * nby * nbz);
+
+    // a layer of bricks spans BRICK_SIZE + 1 grid planes; for memory-mapped
+    // grids, the layers are processed in windows such that the planes of a
+    // window and those of the next window (which are read ahead) fit within
+    // the limit, and the planes of every window are released afterwards
+    size_t window = nbz;
+    if(this->mapping && _max_planes > 0) {
+        window = std::max<size_t>(1, (_max_planes / 2 - 1) / BRICK_SIZE);
+    }
+
+    if(window < nbz) {
+        this->prefetch_planes(0, window * BRICK_SIZE + 1);
+    }
+    for(size_t bz0=0; bz0<nbz; bz0+=window) {
+        const size_t bz1 = std::min(bz0 + window, nbz);
+        if(window < nbz) {
+            this->prefetch_planes(bz1 * BRICK_SIZE, (bz1 + window) * BRICK_SIZE + 1);
+        }
+
+        parallel_for(bz0, bz1, [&](size_t bz) {
+            const size_t z1 = std::min((bz + 1) * BRICK_SIZE, this->grid_dimensions[2] - 1);
+            for(size_t by=0; by<nby; by++) {
+                const size_t y1 = std::min((by + 1) * BRICK_SIZE, this->grid_dimensions[1] - 1);
+                for(size_t bx=0; bx<nbx; bx++) {
+                    const size_t x1 = std::min((bx + 1) * BRICK_SIZE, this->grid_dimensions[0] - 1);
+                    const std::pair<float, float> minmax = this->visit([&](const auto* values) {
+                        auto vmin = values[(bz * BRICK_SIZE * this->grid_dimensions[1] + by * BRICK_SIZE) *
+                                           this->grid_dimensions[0] + bx * BRICK_SIZE];
+                        auto vmax = vmin;
+                        for(size_t z=bz * BRICK_SIZE; z<=z1; z++) {
+                            for(size_t y=by * BRICK_SIZE; y<=y1; y++) {
+                                const auto* row = values + (z * this->grid_dimensions[1] + y) * this->grid_dimensions[0];
+                                for(size_t x=bx * BRICK_SIZE; x<=x1; x++) {
+                                    vmin = std::min(vmin, row[x]);
+                                    vmax = std::max(vmax, row[x]);
+                                }
+                            }
+                        }
+                        return std::make_pair(static_cast<float>(vmin), static_cast<float>(vmax));
+                    });
+                    this->brick_min[(bz * nby + by) * nbx + bx] = minmax.first;
+                    this->brick_max[(bz * nby + by) * nbx + bx] = minmax.second;
+                }
+            }
+        }, Schedule::DYNAMIC);
+
+        if(window < nbz) {
+            this->release_planes(bz0 * BRICK_SIZE, bz1 * BRICK_SIZE);
+        }
+    }
+
+    this->bricks_built.store(true, std::memory_order_release);
+}
+
+/**
+ * @brief      collect the ranges along x of a row of cubes or grid
+ *             points which lie in bricks straddling the isovalue
+ *
+ * @param[in]  j          y index of the row
+ * @param[in]  k          z index of the row
+ * @param[in]  isovalue   The isovalue
+ * @param[in]  begin      first cube or grid point of the row to consider
+ * @param[in]  end        one past the last cube or grid point to consider
+ * @param      ranges     list of [begin, end) ranges
+ */
+void ScalarField::get_active_ranges(size_t j, size_t k, float isovalue, size_t begin, size_t end,
+                                    std::vector<std::pair<size_t, size_t>>& ranges) const {
+    this->build_bricks();
+    ranges.clear();
+
+    // grid points on the upper face of the grid belong to the last brick
+    const size_t nbx = this->brick_dimensions[0];
+    const size_t by = std::min(j / BRICK_SIZE, this->brick_dimensions[1] - 1);
+    const size_t bz = std::min(k / BRICK_SIZE, this->brick_dimensions[2] - 1);
+    const size_t offset = (bz * this->brick_dimensions[1] + by) * nbx;
+
+    if(begin >= end) {
+        return;
+    }
+    const size_t bxend = std::min(nbx, (end - 1) / BRICK_SIZE + 1);
+    for(size_t bx=begin / BRICK_SIZE; bx<bxend; bx++) {
+        // a brick is active when at least one grid point lies below and one
+        // grid point lies on or above the isovalue
+        if(!(this->brick_min[offset + bx] < isovalue && this->brick_max[offset + bx] >= isovalue)) {
+            continue;
+        }
+
+        const size_t rbegin = std::max(bx * BRICK_SIZE, begin);
+        const size_t rend = (bx == nbx - 1) ? end : std::min((bx + 1) * BRICK_SIZE, end);
+        if(!ranges.empty() && ranges.back().second == rbegin) {
+            ranges.back().second = rend;
+        } else {
+            ranges.emplace_back(rbegin, rend);
+        }
+    }
+}
+
+/**
+ * @brief      calculate the gradient (in grid units) at a grid point
+ *             using central differences, or one-sided differences at
+ *             the boundaries of the grid
+ *
+ * @param[in]  i     x index
+ * @param[in]  j     y index
+ * @param[in]  k     z index
+ *
+ * @return     gradient
+ */
+Vec3 ScalarField::get_gradient(size_t i, size_t j, size_t k) const {
+    if(this->gradients_built.load(std::memory_order_acquire)) {
+        return this->gradients[(k * this->grid_dimensions[1] + j) * this->grid_dimensions[0] + i];
+    }
+
+    const size_t p[3] = {i, j, k};
+    float g[3];
+    for(size_t a=0; a<3; a++) {
+        size_t p0[3] = {i, j, k};
+        size_t p1[3] = {i, j, k};
+        p0[a] = p[a] > 0 ? p[a] - 1 : p[a];
+        p1[a] = p[a] + 1 < this->grid_dimensions[a] ? p[a] + 1 : p[a];
+        if(p1[a] == p0[a]) {
+            g[a] = 0.0f;
+            continue;
+        }
+        g[a] = (this->get_value(p1[0], p1[1], p1[2]) - this->get_value(p0[0], p0[1], p0[2])) /
+               (float)(p1[a] - p0[a]);
+    }
+
+    return Vec3(g[0], g[1], g[2]);
+}
+
+/**
+ * @brief      convert a gradient in grid units to real space
+ *
+ * A grid position g corresponds to the real space position r = U^T D^-1 g,
+ * with U the unitcell matrix (lattice vectors as rows) and D the diagonal
+ * matrix of the grid dimensions. Hence the gradient in real space is
+ * given by U^-1 D times the gradient in grid units.
+ *
+ * @param[in]  g     gradient in grid units
+ *
+ * @return     gradient in real space
+ */
+Vec3 ScalarField::gradient_to_realspace(const Vec3& g) const {
+    const float d[3] = {
+        g.x * (float)this->grid_dimensions[0],
+        g.y * (float)this->grid_dimensions[1],
+        g.z * (float)this->grid_dimensions[2]
+    };
+
+    Vec3 r;
+    r.x = this->unitcell_inverse[0][0] * d[0] + this->unitcell_inverse[0][1] * d[1] + this->unitcell_inverse[0][2] * d[2];
+    r.y = this->unitcell_inverse[1][0] * d[0] + this->unitcell_inverse[1][1] * d[1] + this->unitcell_inverse[1][2] * d[2];
+    r.z = this->unitcell_inverse[2][0] * d[0] + this->unitcell_inverse[2][1] * d[1] + this->unitcell_inverse[2][2] * d[2];
+
+    return r;
+}
+
+/**
+ * @brief      build the gradient volume such that get_gradient merely
+ *             performs a lookup
+ */
+void ScalarField::build_gradients() const {
+    if(this->gradients_built.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(this->gradients_mutex);
+    if(this->gradients_built.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    const size_t nx = this->grid_dimensions[0];
+    const size_t ny = this->grid_dimensions[1];
+    const size_t nz = this->grid_dimensions[2];
+    this->gradients.resize(nx * ny * nz);
+
+    parallel_for(0, nz, [&](size_t k) {
+        for(size_t j=0; j<ny; j++) {
+            for(size_t i=0; i<nx; i++) {
+                this->gradients[(k * ny + j) * nx + i] = this->get_gradient(i, j, k);
+            }
+        }
+    }, Schedule::STATIC);
+
+    this->gradients_built.store(true, std::memory_order_release);
+}
+
+/**
+ * @brief      release the gradient volume, after which the gradients are
+ *             calculated on the fly again; should not be called while an
+ *             isosurface of the scalar field is being extracted
+ */
+void ScalarField::release_gradients() const {
+    std::lock_guard<std::mutex> lock(this->gradients_mutex);
+    this->gradients_built.store(false, std::memory_order_release);
+    std::vector<Vec3>().swap(this->gradients);
 }
 
 void ScalarField::inverse(const mat33& mat, mat33* invmat) {
@@ -24,29 +24,163 @@
 #include <vector>
 #include <array>
 #include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <stdexcept>
 
 #include "vec3.h"
+#include "mapped_file.h"
+
+// number of cubes along each edge of a brick in the min/max table
+#define BRICK_SIZE 8
+
+/**
+ * @brief      element type of the grid values
+ */
+enum class ScalarType {
+    FLOAT32,
+    FLOAT64,
+    INT8,
+    UINT8,
+    INT16,
+    UINT16,
+    INT32,
+    UINT32
+};
 
 class ScalarField{
 private:
     std::array<size_t, 3> grid_dimensions;
-    std::vector<float> grid;
+    std::vector<float> grid;        // owned storage (only when constructed from a vector)
+    const void* data;               // grid values, either owned or an external buffer
+    std::shared_ptr<MappedFile> mapping;    // memory-mapped file holding the grid values (optional)
+    ScalarType dtype;               // element type of the grid values
     mat33 unitcell;
     mat33 unitcell_inverse;
 
+    // minimum and maximum value of the grid points of every brick
+    std::array<size_t, 3> brick_dimensions;
+    mutable std::vector<float> brick_min;
+    mutable std::vector<float> brick_max;
+    mutable std::atomic<bool> bricks_built;
+    mutable std::mutex bricks_mutex;
+
+    // gradient (in grid units) at every grid point (optional)
+    mutable std::vector<Vec3> gradients;
+    mutable std::atomic<bool> gradients_built;
+    mutable std::mutex gradients_mutex;
+
 public:
 
     /**
-     * @brief      constructor
+     * @brief      constructor taking ownership of the grid values; see
+     *             field_readers.h to construct a scalar field from a CUBE or
+     *             CHGCAR/LOCPOT file
      *
-     * @param[in]  _filename        url to filename
-     * @param[in]  _flag_is_locpot  whether this file is a locpot
-     * @param[in]  _is_bin          is binary file
+     * @param[in]  grid        grid values (x fastest moving)
+     * @param[in]  dimensions  grid dimensions (nx, ny, nz)
+     * @param[in]  unitcell    unitcell matrix (flattened)
      */
-    ScalarField(const std::vector<float>& grid,
+    ScalarField(std::vector<float> grid,
                 const std::vector<size_t>& dimensions,
                 const std::vector<float>& unitcell);
 
+    /**
+     * @brief      constructor referencing an external buffer without copying;
+     *             the buffer needs to outlive the scalar field
+     *
+     * @param[in]  data        pointer to the grid values (x fastest moving)
+     * @param[in]  dtype       element type as typecode and number of bytes,
+     *                         e.g. "f4", "f8", "i2" or "u1"
+     * @param[in]  dimensions  grid dimensions (nx, ny, nz)
+     * @param[in]  unitcell    unitcell matrix (flattened)
+     */
+    ScalarField(const void* data,
+                const std::string& dtype,
+                const std::vector<size_t>& dimensions,
+                const std::vector<float>& unitcell);
+
+    /**
+     * @brief      constructor referencing the grid values in a memory-mapped
+     *             file, such that grids larger than the available memory can
+     *             be processed; the mapping is retained by the scalar field
+     *
+     * @param[in]  mapping     the mapped file
+     * @param[in]  offset      offset of the grid values in bytes
+     * @param[in]  dtype       element type as typecode and number of bytes
+     * @param[in]  dimensions  grid dimensions (nx, ny, nz)
+     * @param[in]  unitcell    unitcell matrix (flattened)
+     */
+    ScalarField(const std::shared_ptr<MappedFile>& mapping,
+                size_t offset,
+                const std::string& dtype,
+                const std::vector<size_t>& dimensions,
+                const std::vector<float>& unitcell);
+
+    /**
+     * @brief      call a function with a typed pointer to the grid values
+     *
+     * @param[in]  func  generic callable taking a `const T*`
+     *
+     * @return     return value of the callable
+     */
+    template<typename F>
+    inline auto visit(F&& func) const {
+        switch(this->dtype) {
+            case ScalarType::FLOAT64: return func(static_cast<const double*>(this->data));
+            case ScalarType::INT8:    return func(static_cast<const int8_t*>(this->data));
+            case ScalarType::UINT8:   return func(static_cast<const uint8_t*>(this->data));
+            case ScalarType::INT16:   return func(static_cast<const int16_t*>(this->data));
+            case ScalarType::UINT16:  return func(static_cast<const uint16_t*>(this->data));
+            case ScalarType::INT32:   return func(static_cast<const int32_t*>(this->data));
+            case ScalarType::UINT32:  return func(static_cast<const uint32_t*>(this->data));
+            default:                  return func(static_cast<const float*>(this->data));
+        }
+    }
+
+    inline ScalarType get_dtype() const {
+        return this->dtype;
+    }
+
+    inline const void* get_data() const {
+        return this->data;
+    }
+
+    /**
+     * @brief      get the number of bytes occupied by a plane of grid points
+     *
+     * @return     number of bytes
+     */
+    inline size_t get_plane_bytes() const {
+        return this->grid_dimensions[0] * this->grid_dimensions[1] *
+               this->visit([](const auto* values) { return sizeof(*values); });
+    }
+
+    inline bool is_mapped() const {
+        return static_cast<bool>(this->mapping);
+    }
+
+    /**
+     * @brief      hint that the grid planes [z0, z1) are about to be read;
+     *             only affects memory-mapped grids
+     *
+     * @param[in]  z0    first plane
+     * @param[in]  z1    one past the last plane
+     */
+    void prefetch_planes(size_t z0, size_t z1) const;
+
+    /**
+     * @brief      hint that the grid planes [z0, z1) are no longer needed,
+     *             such that their pages are released; only affects
+     *             memory-mapped grids
+     *
+     * @param[in]  z0    first plane
+     * @param[in]  z1    one past the last plane
+     */
+    void release_planes(size_t z0, size_t z1) const;
+
      /*
      * float get_value_interp(x,y,z)
      *
@@ -61,7 +195,45 @@ public:
      */
     float get_value_interp(float x, float y, float z) const;
 
-    float get_value(size_t i, size_t j, size_t k) const;
+    inline float get_value(size_t i, size_t j, size_t k) const {
+        const size_t idx = (k * this->grid_dimensions[1] + j) * this->grid_dimensions[0] + i;
+        if(this->dtype == ScalarType::FLOAT32) {
+            return static_cast<const float*>(this->data)[idx];
+        }
+        return this->visit([idx](const auto* values) {
+            return static_cast<float>(values[idx]);
+        });
+    }
+
+    /**
+     * @brief      get pointer to a row of grid points along x as floats
+     *
+     * For single precision grids, a pointer into the grid is returned;
+     * otherwise the grid points [begin, end) of the row are converted into
+     * the same positions of the buffer.
+     *
+     * @param[in]  j       y index of the row
+     * @param[in]  k       z index of the row
+     * @param      buffer  scratch space for (at least) nx values
+     * @param[in]  begin   first grid point which is accessed
+     * @param[in]  end     one past the last grid point which is accessed
+     *                     (defaults to the complete row)
+     *
+     * @return     pointer to the first grid point of the row
+     */
+    inline const float* get_row(size_t j, size_t k, float* buffer,
+                                size_t begin = 0, size_t end = SIZE_MAX) const {
+        const size_t nx = this->grid_dimensions[0];
+        const size_t offset = (k * this->grid_dimensions[1] + j) * nx;
+        if(this->dtype == ScalarType::FLOAT32) {
+            return static_cast<const float*>(this->data) + offset;
+        }
+        end = std::min(end, nx);
+        this->visit([offset, begin, end, buffer](const auto* values) {
+            std::copy(values + offset + begin, values + offset + end, buffer + begin);
+        });
+        return buffer;
+    }
 
     Vec3 grid_to_realspace(float i, float j, float k) const;
 
@@ -75,6 +247,73 @@ public:
 
     float get_min() const;
 
+    /**
+     * @brief      build the table holding the minimum and maximum value of
+     *             every brick of BRICK_SIZE^3 cubes (including the grid
+     *             points on its upper faces); the table is only built once
+     *             and building is safe to call from multiple threads
+     *
+     * @param[in]  max_planes  for memory-mapped grids: maximum number of
+     *                         grid planes resident at once, the grid is then
+     *                         swept in windows of planes (0: no limit)
+     */
+    void build_bricks(size_t max_planes = 0) const;
+
+    /**
+     * @brief      collect the ranges along x of a row of cubes or grid
+     *             points which lie in bricks straddling the isovalue
+     *
+     * Cubes (or edges between grid points) outside of these ranges cannot
+     * be intersected by the isosurface.
+     *
+     * @param[in]  j          y index of the row
+     * @param[in]  k          z index of the row
+     * @param[in]  isovalue   The isovalue
+     * @param[in]  begin      first cube or grid point of the row to consider
+     * @param[in]  end        one past the last cube or grid point to
+     *                        consider; the last brick of the row extends up
+     *                        to end
+     * @param      ranges     list of [begin, end) ranges
+     */
+    void get_active_ranges(size_t j, size_t k, float isovalue, size_t begin, size_t end,
+                           std::vector<std::pair<size_t, size_t>>& ranges) const;
+
+    /**
+     * @brief      calculate the gradient (in grid units) at a grid point
+     *             using central differences, or one-sided differences at
+     *             the boundaries of the grid
+     *
+     * @param[in]  i     x index
+     * @param[in]  j     y index
+     * @param[in]  k     z index
+     *
+     * @return     gradient
+     */
+    Vec3 get_gradient(size_t i, size_t j, size_t k) const;
+
+    /**
+     * @brief      convert a gradient in grid units to real space
+     *
+     * @param[in]  g     gradient in grid units
+     *
+     * @return     gradient in real space
+     */
+    Vec3 gradient_to_realspace(const Vec3& g) const;
+
+    /**
+     * @brief      build the gradient volume such that get_gradient merely
+     *             performs a lookup; the volume is only built once and
+     *             building is safe to call from multiple threads
+     */
+    void build_gradients() const;
+
+    /**
+     * @brief      release the gradient volume, after which the gradients are
+     *             calculated on the fly again; should not be called while an
+     *             isosurface of the scalar field is being extracted
+     */
+    void release_gradients() const;
+
     /**
      * @brief      test whether point is inside unit cell
      *
@@ -0,0 +1,71 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   PyTessel is free software:                                           *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   PyTessel is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "tessellator.h"
+
+/**
+ * @brief      start an extraction session
+ *
+ * @param[in]  _sf               pointer to scalar field
+ * @param[in]  _method           the algorithm
+ * @param[in]  _compute_normals  whether to calculate the normals from the
+ *                               gradient on the grid
+ * @param[in]  _cache_gradients  whether to precompute the gradient volume
+ */
+Tessellator::Tessellator(const std::shared_ptr<ScalarField>& _sf,
+                         ExtractionMethod _method,
+                         bool _compute_normals,
+                         bool _cache_gradients) :
+    sf(_sf),
+    is(std::make_shared<IsoSurface>(_sf)),
+    method(_method) {
+    this->is->set_compute_normals(_compute_normals);
+    this->is->set_keep_buffers(true);
+
+    // the acceleration data only depends on the scalar field and is hence
+    // shared by all extractions
+    this->sf->build_bricks();
+    if(_cache_gradients) {
+        this->sf->build_gradients();
+    }
+}
+
+/**
+ * @brief      construct the (centered) isosurface mesh for an isovalue
+ *
+ * The mesh of the previous extraction is recycled when it is no longer
+ * referenced by anyone else, such that its buffers are reused.
+ *
+ * @param[in]  _isovalue  The isovalue
+ *
+ * @return     the isosurface mesh
+ */
+std::shared_ptr<IsoSurfaceMesh> Tessellator::extract(float _isovalue) {
+    this->is->extract(_isovalue, this->method);
+
+    if(!this->mesh || this->mesh.use_count() > 1) {
+        this->mesh = std::make_shared<IsoSurfaceMesh>(this->sf, this->is);
+    } else {
+        this->mesh->set_isosurface(this->sf, this->is);
+    }
+    this->mesh->construct_mesh(true);
+
+    return this->mesh;
+}
@@ -0,0 +1,76 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   PyTessel is free software:                                           *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   PyTessel is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#pragma once
+
+#include <memory>
+
+#include "scalar_field.h"
+#include "isosurface.h"
+#include "isosurface_mesh.h"
+
+/**
+ * @brief      Extraction session for a single scalar field; constructs
+ *             isosurfaces for arbitrary isovalues while retaining the
+ *             scalar field, its acceleration data and all scratch space
+ *             between the extractions
+ */
+class Tessellator {
+private:
+    std::shared_ptr<ScalarField> sf;        // the scalar field
+    std::shared_ptr<IsoSurface> is;         // isosurface retaining its buffers
+    std::shared_ptr<IsoSurfaceMesh> mesh;   // most recently constructed mesh
+    ExtractionMethod method;                // extraction algorithm
+
+public:
+    /**
+     * @brief      start an extraction session
+     *
+     * @param[in]  _sf               pointer to scalar field
+     * @param[in]  _method           the algorithm
+     * @param[in]  _compute_normals  whether to calculate the normals from the
+     *                               gradient on the grid
+     * @param[in]  _cache_gradients  whether to precompute the gradient volume
+     */
+    Tessellator(const std::shared_ptr<ScalarField>& _sf,
+                ExtractionMethod _method,
+                bool _compute_normals,
+                bool _cache_gradients);
+
+    /**
+     * @brief      construct the (centered) isosurface mesh for an isovalue
+     *
+     * The mesh of the previous extraction is recycled when it is no longer
+     * referenced by anyone else, such that its buffers are reused.
+     *
+     * @param[in]  _isovalue  The isovalue
+     *
+     * @return     the isosurface mesh
+     */
+    std::shared_ptr<IsoSurfaceMesh> extract(float _isovalue);
+
+    inline const std::shared_ptr<ScalarField>& get_scalar_field() const {
+        return this->sf;
+    }
+
+    inline const std::shared_ptr<IsoSurface>& get_isosurface() const {
+        return this->is;
+    }
+};
@@ -0,0 +1,156 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   PyTessel is free software:                                           *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   PyTessel is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+// trace buffer and phase of the calling thread
+static thread_local TraceBuffer* trace_buffer = nullptr;
+static thread_local const char* trace_phase = nullptr;
+
+/**
+ * @brief      get a small id of the calling thread, assigned in the order in
+ *             which the threads record their first event
+ */
+static uint32_t get_trace_thread_id() {
+    static std::atomic<uint32_t> nrthreads(0);
+    static thread_local uint32_t id = nrthreads++;
+    return id;
+}
+
+/**
+ * @brief      build an empty trace buffer
+ *
+ * @param[in]  _capacity  maximum number of retained events
+ */
+TraceBuffer::TraceBuffer(size_t _capacity) :
+    events(std::max<size_t>(1, _capacity)),
+    nrevents(0),
+    epoch(std::chrono::steady_clock::now()) {
+}
+
+/**
+ * @brief      record an event; may be called concurrently
+ *
+ * @param[in]  _name      name of the event (string literal)
+ * @param[in]  _category  category of the event (string literal)
+ * @param[in]  _start     start of the event
+ * @param[in]  _stop      end of the event
+ * @param[in]  _begin     first iteration of a chunk
+ * @param[in]  _end       one past the last iteration of a chunk
+ */
+void TraceBuffer::record(const char* _name, const char* _category,
+                         const std::chrono::steady_clock::time_point& _start,
+                         const std::chrono::steady_clock::time_point& _stop,
+                         size_t _begin, size_t _end) {
+    TraceEvent& event = this->events[this->nrevents.fetch_add(1, std::memory_order_relaxed) % this->events.size()];
+    event.name = _name;
+    event.category = _category;
+    event.thread = get_trace_thread_id();
+    event.start = std::chrono::duration_cast<std::chrono::nanoseconds>(_start - this->epoch).count();
+    event.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(_stop - _start).count();
+    event.begin = _begin;
+    event.end = _end;
+}
+
+/**
+ * @brief      write the retained events as a Chrome trace (JSON)
+ *
+ * Every event is written as a complete event ("ph": "X") with timestamps in
+ * microseconds; chunks carry the range of iterations as arguments.
+ *
+ * @param[in]  _filename  path to the output file
+ */
+void TraceBuffer::write_chrome_trace(const std::string& _filename) const {
+    std::ofstream out(_filename);
+    if(!out) {
+        throw std::runtime_error("Cannot open trace file: " + _filename);
+    }
+
+    const uint64_t nrrecorded = this->nrevents.load(std::memory_order_acquire);
+    const uint64_t capacity = this->events.size();
+    const uint64_t first = nrrecorded > capacity ? nrrecorded - capacity : 0;
+
+    out << "{\"displayTimeUnit\": \"ms\", \"otherData\": {\"dropped_events\": " << first << "},\n";
+    out << "\"traceEvents\": [";
+    char buffer[512];
+    for(uint64_t i=first; i<nrrecorded; i++) {
+        const TraceEvent& event = this->events[i % capacity];
+        int n = std::snprintf(buffer, sizeof(buffer),
+                              "%s\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 0, \"tid\": %u, "
+                              "\"ts\": %.3f, \"dur\": %.3f",
+                              i == first ? "" : ",", event.name, event.category, event.thread,
+                              event.start * 1e-3, event.duration * 1e-3);
+        out.write(buffer, n);
+        if(event.end > event.begin) {
+            n = std::snprintf(buffer, sizeof(buffer), ", \"args\": {\"begin\": %zu, \"end\": %zu}",
+                              event.begin, event.end);
+            out.write(buffer, n);
+        }
+        out << "}";
+    }
+    out << "\n]}\n";
+
+    if(!out) {
+        throw std::runtime_error("Cannot write trace file: " + _filename);
+    }
+}
+
+/**
+ * @brief      set the trace buffer recording the phases and parallel loops
+ *             started from the calling thread
+ *
+ * @param      _buffer  the trace buffer; nullptr disables tracing
+ */
+void set_trace_buffer(TraceBuffer* _buffer) {
+    trace_buffer = _buffer;
+}
+
+/**
+ * @brief      get the trace buffer of the calling thread
+ *
+ * @return     the trace buffer or nullptr when tracing is disabled
+ */
+TraceBuffer* get_trace_buffer() {
+    return trace_buffer;
+}
+
+/**
+ * @brief      set the phase executed by the calling thread; chunks of
+ *             parallel loops are named after the phase that started them
+ *
+ * @param[in]  _phase  name of the phase (string literal) or nullptr
+ */
+void set_trace_phase(const char* _phase) {
+    trace_phase = _phase;
+}
+
+/**
+ * @brief      get the phase executed by the calling thread
+ *
+ * @return     name of the phase or nullptr
+ */
+const char* get_trace_phase() {
+    return trace_phase;
+}
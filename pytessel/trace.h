@@ -0,0 +1,116 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   PyTessel is free software:                                           *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   PyTessel is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// default number of events retained by a trace buffer
+#define TRACE_BUFFER_CAPACITY (1 << 18)
+
+/**
+ * @brief      a single timed event executed by a thread: either a phase of
+ *             an algorithm or a chunk of iterations of a parallel loop
+ */
+struct TraceEvent {
+    const char* name;       // name of the phase (string literal)
+    const char* category;   // "phase" or "chunk" (string literal)
+    uint32_t thread;        // id of the executing thread
+    uint64_t start;         // start time in nanoseconds since the epoch of the buffer
+    uint64_t duration;      // duration in nanoseconds
+    size_t begin;           // first iteration of a chunk
+    size_t end;             // one past the last iteration of a chunk
+};
+
+/**
+ * @brief      ring buffer of trace events which can be written as a Chrome
+ *             trace (viewable using chrome://tracing or Perfetto); once the
+ *             buffer is full, the oldest events are overwritten
+ */
+class TraceBuffer {
+private:
+    std::vector<TraceEvent> events;
+    std::atomic<uint64_t> nrevents;                 // number of events ever recorded
+    std::chrono::steady_clock::time_point epoch;    // time point of timestamp zero
+
+public:
+    /**
+     * @brief      build an empty trace buffer
+     *
+     * @param[in]  _capacity  maximum number of retained events
+     */
+    explicit TraceBuffer(size_t _capacity = TRACE_BUFFER_CAPACITY);
+
+    /**
+     * @brief      record an event; may be called concurrently
+     *
+     * @param[in]  _name      name of the event (string literal)
+     * @param[in]  _category  category of the event (string literal)
+     * @param[in]  _start     start of the event
+     * @param[in]  _stop      end of the event
+     * @param[in]  _begin     first iteration of a chunk
+     * @param[in]  _end       one past the last iteration of a chunk
+     */
+    void record(const char* _name, const char* _category,
+                const std::chrono::steady_clock::time_point& _start,
+                const std::chrono::steady_clock::time_point& _stop,
+                size_t _begin = 0, size_t _end = 0);
+
+    /**
+     * @brief      write the retained events as a Chrome trace (JSON)
+     *
+     * @param[in]  _filename  path to the output file
+     */
+    void write_chrome_trace(const std::string& _filename) const;
+};
+
+/**
+ * @brief      set the trace buffer recording the phases and parallel loops
+ *             started from the calling thread
+ *
+ * @param      _buffer  the trace buffer; nullptr disables tracing
+ */
+void set_trace_buffer(TraceBuffer* _buffer);
+
+/**
+ * @brief      get the trace buffer of the calling thread
+ *
+ * @return     the trace buffer or nullptr when tracing is disabled
+ */
+TraceBuffer* get_trace_buffer();
+
+/**
+ * @brief      set the phase executed by the calling thread; chunks of
+ *             parallel loops are named after the phase that started them
+ *
+ * @param[in]  _phase  name of the phase (string literal) or nullptr
+ */
+void set_trace_phase(const char* _phase);
+
+/**
+ * @brief      get the phase executed by the calling thread
+ *
+ * @return     name of the phase or nullptr
+ */
+const char* get_trace_phase();
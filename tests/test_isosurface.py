@@ -1,11 +1,12 @@
 import unittest
 import numpy as np
-import sys, os
+import sys, os, gc, json, subprocess, tempfile, threading, weakref
+from concurrent.futures import ThreadPoolExecutor
 
 # add a reference to load the pytessel library
 sys.path.append(os.path.join(os.path.dirname(__file__), '..'))
 
-from pytessel import PyTessel
+from pytessel import PyTessel, Tessellator
 
 class TestIsoSurface(unittest.TestCase):
 
@@ -16,13 +17,7 @@ class TestIsoSurface(unittest.TestCase):
         pytessel = PyTessel()
 
         # generate some data
-        x = np.linspace(0, 10, 20)
-        # the grid is organized with z the slowest moving index and x the fastest moving index
-        grid = np.flipud(np.vstack(np.meshgrid(x, x, x, indexing='ij')).reshape(3,-1)).T
-
-        R = [5,5,5]
-        scalarfield = np.reshape(np.array([gaussian(r,R) for r in grid]), (len(x),len(x),len(x)), order='F')
-        unitcell = np.diag(np.ones(3) * 10.0)
+        scalarfield, unitcell = gaussian_field([5,5,5])
 
         vertices, normals, indices = pytessel.marching_cubes(scalarfield.flatten(), scalarfield.shape, unitcell.flatten(), 0.1)
 
@@ -30,8 +25,627 @@ class TestIsoSurface(unittest.TestCase):
         self.assertEqual(len(normals),  144)
         self.assertEqual(len(indices),  852)
 
+    def testIsosurfaceStreaming(self):
+        """
+        Test that the streaming algorithm yields the same isosurface
+        """
+        pytessel = PyTessel()
+
+        scalarfield, unitcell = gaussian_field([4,5,6])
+
+        ref = pytessel.marching_cubes(scalarfield.flatten(), scalarfield.shape, unitcell.flatten(), 0.1)
+        res = pytessel.marching_cubes(scalarfield.flatten(), scalarfield.shape, unitcell.flatten(), 0.1,
+                                      method='streaming')
+
+        for a,b in zip(ref, res):
+            np.testing.assert_array_equal(a, b)
+
+        with self.assertRaises(ValueError):
+            pytessel.marching_cubes(scalarfield.flatten(), scalarfield.shape, unitcell.flatten(), 0.1,
+                                    method='unknown')
+
+    def testIsosurfaceFile(self):
+        """
+        Test the tiled extraction from memory-mapped .npy and raw files
+        """
+        pytessel = PyTessel()
+
+        scalarfield, unitcell = gaussian_field([4,5,6])
+        scalarfield = scalarfield.astype(np.float32)
+
+        ref = pytessel.marching_cubes(scalarfield.flatten(), scalarfield.shape, unitcell.flatten(), 0.1,
+                                      normals='gradient')
+
+        with tempfile.TemporaryDirectory() as tmpdir:
+            npyfile = os.path.join(tmpdir, 'field.npy')
+            rawfile = os.path.join(tmpdir, 'field.raw')
+            np.save(npyfile, np.ascontiguousarray(scalarfield))
+            scalarfield.astype(np.float64).tofile(rawfile)
+
+            # a budget of a few planes enforces several tiles
+            for budget in (1, 1 << 30):
+                res = pytessel.marching_cubes_file(npyfile, unitcell.flatten(), 0.1, memory_budget=budget)
+                for a,b in zip(ref, res):
+                    np.testing.assert_array_almost_equal(a, b)
+
+            # the file is no longer mapped while the arrays are alive
+            if os.path.exists('/proc/self/maps'):
+                with open('/proc/self/maps') as f:
+                    self.assertNotIn(npyfile, f.read())
+
+            res = pytessel.marching_cubes_file(rawfile, unitcell.flatten(), 0.1, dimensions=scalarfield.shape,
+                                               dtype='f8', memory_budget=1)
+            self.assertEqual(len(res[2]), len(ref[2]))
+
+            with self.assertRaises(ValueError):
+                pytessel.marching_cubes_file(rawfile, unitcell.flatten(), 0.1, dimensions=(20,20,21), dtype='f8')
+            with self.assertRaises(RuntimeError):
+                pytessel.marching_cubes_file(rawfile, unitcell.flatten(), 0.1)
+
+    def testIsosurfaceReaders(self):
+        """
+        Test reading scalar fields from CUBE and CHGCAR files
+        """
+        pytessel = PyTessel()
+
+        scalarfield, _ = gaussian_field([4,5,6])
+        scalarfield = np.ascontiguousarray(scalarfield[:, :18, :16], dtype=np.float32)
+        unitcell = np.diag([8.0, 9.0, 10.0])
+        nz, ny, nx = scalarfield.shape
+
+        with tempfile.TemporaryDirectory() as tmpdir:
+            # CUBE files store the values with z as the fastest moving index
+            cubefile = os.path.join(tmpdir, 'field.cube')
+            with open(cubefile, 'w') as f:
+                f.write('comment\ncomment\n    1    0.000000    0.000000    0.000000\n')
+                for n, v in zip((nx, ny, nz), unitcell):
+                    f.write('%5i %12.6f %12.6f %12.6f\n' % (n, *(v / n)))
+                f.write('    1    1.000000    0.000000    0.000000    0.000000\n')
+                values = scalarfield.transpose(2, 1, 0).reshape(-1)
+                for i in range(0, len(values), 6):
+                    f.write(''.join(' %12.5E' % v for v in values[i:i+6]) + '\n')
+
+            # CHGCAR files store the density times the volume of the unitcell
+            chgcarfile = os.path.join(tmpdir, 'CHGCAR')
+            with open(chgcarfile, 'w') as f:
+                f.write('comment\n1.0\n')
+                for v in unitcell:
+                    f.write(' %12.6f %12.6f %12.6f\n' % tuple(v))
+                f.write('   H\n   1\nDirect\n  0.0 0.0 0.0\n\n%5i%5i%5i\n' % (nx, ny, nz))
+                values = scalarfield.reshape(-1) * np.linalg.det(unitcell)
+                for i in range(0, len(values), 5):
+                    f.write(''.join(' %17.11E' % v for v in values[i:i+5]) + '\n')
+                f.write('augmentation occupancies   1   2\n  0.1 0.2\n')
+
+            for res, resunitcell in (pytessel.read_cube(cubefile), pytessel.read_chgcar(chgcarfile)):
+                self.assertEqual(res.shape, scalarfield.shape)
+                np.testing.assert_allclose(res, scalarfield, rtol=1e-4, atol=1e-7)
+                np.testing.assert_allclose(resunitcell, unitcell, rtol=1e-6)
+
+            res, resunitcell = pytessel.read_chgcar(chgcarfile, locpot=True)
+            np.testing.assert_allclose(res, scalarfield * np.linalg.det(unitcell), rtol=1e-4)
+
+            mesh = pytessel.marching_cubes(res, reversed(res.shape), resunitcell.flatten(), 0.1)
+            self.assertGreater(len(mesh[2]), 0)
+
+            with self.assertRaises(RuntimeError):
+                pytessel.read_cube(chgcarfile)
+
+    def testIsosurfaceWriters(self):
+        """
+        Test writing binary and ASCII PLY and STL files
+        """
+        pytessel = PyTessel()
+
+        scalarfield, unitcell = gaussian_field([4,5,6])
+
+        vertices, normals, indices = pytessel.marching_cubes(scalarfield.flatten(), scalarfield.shape, unitcell.flatten(), 0.1)
+        nrtriangles = len(indices) // 3
+
+        with tempfile.TemporaryDirectory() as tmpdir:
+            plyfile = os.path.join(tmpdir, 'mesh.ply')
+            stlfile = os.path.join(tmpdir, 'mesh.stl')
+
+            # binary PLY: header followed by the vertices and the faces
+            pytessel.write_ply(plyfile, vertices, normals, indices.astype(np.int64))
+            with open(plyfile, 'rb') as f:
+                data = f.read()
+            body = data[data.index(b'end_header\n') + 11:]
+            res = np.frombuffer(body, dtype=np.float32, count=6 * len(vertices)).reshape(-1, 6)
+            np.testing.assert_array_equal(res[:,:3], vertices)
+            np.testing.assert_array_equal(res[:,3:], normals)
+            faces = np.frombuffer(body[res.nbytes:], dtype=[('n', 'u1'), ('i', '<u4', (3,))])
+            np.testing.assert_array_equal(faces['i'].flatten(), indices)
+
+            # ASCII PLY
+            pytessel.write_ply(plyfile, vertices, normals, indices, binary=False)
+            with open(plyfile) as f:
+                lines = f.read().splitlines()
+            start = lines.index('end_header') + 1
+            res = np.array([l.split() for l in lines[start:start + len(vertices)]], dtype=np.float32)
+            np.testing.assert_array_equal(res[:,:3], vertices)
+            self.assertEqual(len(lines), start + len(vertices) + nrtriangles)
+
+            # binary STL: the triangles are stored by their vertices
+            pytessel.write_stl(stlfile, vertices, normals, indices)
+            with open(stlfile, 'rb') as f:
+                data = f.read()
+            self.assertEqual(np.frombuffer(data[80:84], dtype='<u4')[0], nrtriangles)
+            facets = np.frombuffer(data[84:], dtype=[('normal', '<f4', (3,)), ('v', '<f4', (3,3)), ('attr', '<u2')])
+            np.testing.assert_array_equal(facets['v'].reshape(-1, 3), vertices[indices])
+
+            # ASCII STL
+            pytessel.write_stl(stlfile, vertices, normals, indices, binary=False)
+            with open(stlfile) as f:
+                res = np.array([l.split()[1:] for l in f if l.strip().startswith('vertex')], dtype=np.float32)
+            np.testing.assert_array_equal(res, vertices[indices])
+
+            with self.assertRaises(ValueError):
+                pytessel.write_ply(plyfile, vertices, normals, indices + len(vertices))
+
+    def testIsosurfaceToStl(self):
+        """
+        Test writing the isosurface directly to an STL file
+        """
+        pytessel = PyTessel()
+
+        scalarfield, unitcell = gaussian_field([4,5,6])
+
+        vertices, normals, indices = pytessel.marching_cubes(scalarfield.flatten(), scalarfield.shape, unitcell.flatten(), 0.1,
+                                                             normals='gradient')
+
+        with tempfile.TemporaryDirectory() as tmpdir:
+            stlfile = os.path.join(tmpdir, 'mesh.stl')
+            nrtriangles = pytessel.marching_cubes_to_stl(scalarfield.flatten(), scalarfield.shape, unitcell.flatten(),
+                                                         0.1, stlfile)
+            self.assertEqual(nrtriangles, len(indices) // 3)
+
+            # the same (oriented) triangles as the mesh, with a normal per
+            # facet calculated from the gradient
+            with open(stlfile, 'rb') as f:
+                data = f.read()
+            self.assertEqual(np.frombuffer(data[80:84], dtype='<u4')[0], nrtriangles)
+            facets = np.frombuffer(data[84:], dtype=[('normal', '<f4', (3,)), ('v', '<f4', (3,3)), ('attr', '<u2')])
+            np.testing.assert_array_equal(facets['v'].reshape(-1, 3), vertices[indices])
+            meshnormals = normals[indices].reshape(-1, 3, 3).sum(axis=1)
+            meshnormals /= np.linalg.norm(meshnormals, axis=1)[:, None]
+            self.assertGreater(np.min(np.sum(facets['normal'] * meshnormals, axis=1)), 0.5)
+
+            pytessel.marching_cubes_to_stl(scalarfield.flatten(), scalarfield.shape, unitcell.flatten(),
+                                           0.1, stlfile, binary=False)
+            with open(stlfile) as f:
+                self.assertEqual(sum(1 for l in f if l.strip().startswith('facet')), nrtriangles)
+
+    def testIsosurfaceFlyingEdges(self):
+        """
+        Test that the flying edges algorithm yields the same triangles
+        """
+        pytessel = PyTessel()
+
+        scalarfield, unitcell = gaussian_field([4,5,6])
+
+        for isovalue in [0.01, 0.1, 0.5]:
+            ref = pytessel.marching_cubes(scalarfield.flatten(), scalarfield.shape, unitcell.flatten(), isovalue)
+            res = pytessel.marching_cubes(scalarfield.flatten(), scalarfield.shape, unitcell.flatten(), isovalue,
+                                          method='flying_edges')
+
+            # the vertices are ordered differently, hence compare per triangle
+            self.assertEqual(len(ref[0]), len(res[0]))
+            self.assertEqual(len(ref[2]), len(res[2]))
+            np.testing.assert_array_equal(ref[0][ref[2]], res[0][res[2]])
+            np.testing.assert_array_equal(ref[1][ref[2]], res[1][res[2]])
+
+    def testIsosurfaceBricks(self):
+        """
+        Test that the brick-ordered traversal yields the same triangles
+        """
+        pytessel = PyTessel()
+
+        scalarfield, unitcell = gaussian_field([4,5,6], 40)
+
+        for isovalue in [0.01, 0.1, 0.5]:
+            ref = pytessel.marching_cubes(scalarfield.flatten(), scalarfield.shape, unitcell.flatten(), isovalue)
+            res = pytessel.marching_cubes(scalarfield.flatten(), scalarfield.shape, unitcell.flatten(), isovalue,
+                                          method='bricks')
+
+            # both vertices and triangles are ordered by brick, hence compare
+            # the triangles (with the normals at their corners) as sets
+            self.assertEqual(len(ref[0]), len(res[0]))
+            self.assertEqual(len(ref[2]), len(res[2]))
+            tri_ref = np.hstack([ref[0][ref[2]].reshape(-1,9), ref[1][ref[2]].reshape(-1,9)])
+            tri_res = np.hstack([res[0][res[2]].reshape(-1,9), res[1][res[2]].reshape(-1,9)])
+            np.testing.assert_array_equal(np.unique(tri_ref, axis=0), np.unique(tri_res, axis=0))
+
+    def testIsosurfaceThreads(self):
+        """
+        Test that the isosurface does not depend on the number of threads
+        """
+        scalarfield, unitcell = gaussian_field([4,5,6], 40)
+
+        self.assertIn(PyTessel().parallel_backend, ('openmp', 'threads'))
+        self.assertEqual(PyTessel(num_threads=3).num_threads, 3)
+
+        for method in ['cubes', 'streaming', 'bricks', 'flying_edges']:
+            ref = PyTessel(num_threads=1).marching_cubes(scalarfield.flatten(), scalarfield.shape,
+                                                         unitcell.flatten(), 0.1, method=method)
+            res = PyTessel(num_threads=3).marching_cubes(scalarfield.flatten(), scalarfield.shape,
+                                                         unitcell.flatten(), 0.1, method=method)
+            for a,b in zip(ref, res):
+                np.testing.assert_array_equal(a, b)
+
+        with self.assertRaises(ValueError):
+            PyTessel(num_threads=0)
+
+    def testIsosurfaceAsync(self):
+        """
+        Test background and concurrent construction of isosurfaces
+        """
+        pytessel = PyTessel()
+
+        scalarfield, unitcell = gaussian_field([4,5,6], 40)
+
+        isovalues = [0.01, 0.1, 0.5]
+        refs = [pytessel.marching_cubes(scalarfield.flatten(), scalarfield.shape, unitcell.flatten(), isovalue)
+                for isovalue in isovalues]
+
+        futures = [pytessel.marching_cubes_async(scalarfield.flatten(), scalarfield.shape, unitcell.flatten(),
+                                                 isovalue) for isovalue in isovalues]
+        for ref, future in zip(refs, futures):
+            for a,b in zip(ref, future.result()):
+                np.testing.assert_array_equal(a, b)
+
+        # the interpreter lock is released during the construction and the
+        # loops of instances using different numbers of threads run side by side
+        with ThreadPoolExecutor(max_workers=3) as executor:
+            results = list(executor.map(lambda args: PyTessel(num_threads=args[0]).marching_cubes(
+                scalarfield.flatten(), scalarfield.shape, unitcell.flatten(), args[1]),
+                zip((3, 2, 4), isovalues)))
+        for ref, res in zip(refs, results):
+            for a,b in zip(ref, res):
+                np.testing.assert_array_equal(a, b)
+
+        future = pytessel.marching_cubes_async(scalarfield.flatten(), scalarfield.shape, unitcell.flatten(), 0.1,
+                                               method='unknown')
+        with self.assertRaises(ValueError):
+            future.result()
+
+        # the background thread is stopped together with its object
+        del pytessel, future
+        gc.collect()
+        for thread in threading.enumerate():
+            if thread.name.startswith('pytessel'):
+                thread.join(timeout=10)
+                self.assertFalse(thread.is_alive())
+
+    def testIsosurfaceSimd(self):
+        """
+        Test that every instruction set for the classification of the cubes
+        yields the same isosurfaces, including rows whose number of cubes is
+        not a multiple of the vector width
+        """
+        script = (
+            "import hashlib, numpy as np\n"
+            "from pytessel import PyTessel\n"
+            "pytessel = PyTessel()\n"
+            "rng = np.random.default_rng(42)\n"
+            "digest = hashlib.sha256()\n"
+            "for nx in (2, 6, 9, 17, 35, 70):\n"
+            "    scalarfield = rng.random((7, 5, nx), dtype=np.float32)\n"
+            "    for method in ('cubes', 'streaming', 'bricks', 'flying_edges'):\n"
+            "        for res in pytessel.marching_cubes(scalarfield, scalarfield.shape[::-1],\n"
+            "                                           np.diag([nx, 5.0, 7.0]).flatten(), 0.5,\n"
+            "                                           method=method, normals='gradient'):\n"
+            "            digest.update(res.tobytes())\n"
+            "print(pytessel.simd, digest.hexdigest())\n"
+        )
+
+        results = {}
+        for isa in ('scalar', 'sse2', 'avx2', 'avx512'):
+            env = dict(os.environ, PYTESSEL_SIMD=isa)
+            env['PYTHONPATH'] = os.pathsep.join([os.path.join(os.path.dirname(__file__), '..')] +
+                                                 ([env['PYTHONPATH']] if 'PYTHONPATH' in env else []))
+            output = subprocess.run([sys.executable, '-c', script], env=env, check=True,
+                                    capture_output=True, text=True).stdout.split()
+
+            # unsupported instruction sets fall back onto the scalar kernel
+            self.assertIn(output[0], (isa, 'scalar'))
+            results[output[0]] = output[1]
+
+        self.assertIn('scalar', results)
+        self.assertEqual(len(set(results.values())), 1)
+
+    def testIsosurfaceDataTypes(self):
+        """
+        Test that scalar fields of different data types yield the same
+        isosurface as the equivalent single precision scalar field
+        """
+        pytessel = PyTessel()
+
+        scalarfield, unitcell = gaussian_field([4,5,6])
+        scalarfield = np.round(scalarfield * 100)
+
+        for method in ['cubes', 'streaming', 'bricks', 'flying_edges']:
+            ref = pytessel.marching_cubes(scalarfield.astype(np.float32), scalarfield.shape, unitcell.flatten(),
+                                          10.5, method=method)
+            for dtype in [np.float64, np.int16, np.uint8, '>f4']:
+                res = pytessel.marching_cubes(scalarfield.astype(dtype), scalarfield.shape, unitcell.flatten(),
+                                              10.5, method=method)
+                for a,b in zip(ref, res):
+                    np.testing.assert_array_equal(a, b)
+
+        with self.assertRaises(ValueError):
+            pytessel.marching_cubes(scalarfield.flatten()[1:], scalarfield.shape, unitcell.flatten(), 10.5)
+
+    def testIsosurfaceBuffers(self):
+        """
+        Test that the mesh is returned in arrays sharing the memory of the
+        mesh, which remains valid after the mesh itself has gone
+        """
+        pytessel = PyTessel()
+
+        scalarfield, unitcell = gaussian_field([5,5,5])
+
+        vertices, normals, indices = pytessel.marching_cubes(scalarfield.flatten(), scalarfield.shape,
+                                                             unitcell.flatten(), 0.1)
+        ref = [vertices.copy(), normals.copy(), indices.copy()]
+        self.assertEqual(vertices.dtype, np.float32)
+        self.assertEqual(normals.dtype, np.float32)
+        self.assertEqual(indices.dtype, np.uint32)
+        self.assertEqual(vertices.shape, (144, 3))
+        self.assertFalse(indices.flags.owndata)
+
+        del pytessel
+        gc.collect()
+        for a,b in zip(ref, [vertices, normals, indices]):
+            np.testing.assert_array_equal(a, b)
+
+        # the arrays neither keep the grid nor the scalar field alive
+        grid = np.ascontiguousarray(scalarfield, dtype=np.float32)
+        refcount = sys.getrefcount(grid)
+        gridref = weakref.ref(grid)
+        mesh = PyTessel().marching_cubes(grid, grid.shape, unitcell.flatten(), 0.1, normals='cached')
+        self.assertEqual(sys.getrefcount(grid), refcount)
+        del grid
+        gc.collect()
+        self.assertIsNone(gridref())
+        np.testing.assert_array_almost_equal(ref[0], mesh[0])
+
+        # an isovalue beyond the range of the scalar field yields an empty mesh
+        vertices, normals, indices = PyTessel().marching_cubes(scalarfield.flatten(), scalarfield.shape,
+                                                               unitcell.flatten(), 2.0)
+        self.assertEqual(vertices.shape, (0, 3))
+        self.assertEqual(normals.shape, (0, 3))
+        self.assertEqual(indices.shape, (0,))
+
+    def testIsosurfaceNormals(self):
+        """
+        Test the normals calculated from the gradient on the grid for a
+        Gaussian in a non-orthogonal unit cell
+        """
+        pytessel = PyTessel()
+
+        n = 32
+        unitcell = np.array([[6,0,0],[2,6,0],[1,1.5,6]], dtype=np.float64)
+        frac = np.stack(np.meshgrid(*[np.arange(n)/n]*3, indexing='ij'), axis=-1)
+        center = np.ones(3) * 0.5 @ unitcell
+        r = frac @ unitcell - center
+        scalarfield = np.exp(-0.5 * (r**2).sum(axis=-1)).transpose(2,1,0).copy()
+
+        vertices, normals, indices = pytessel.marching_cubes(scalarfield, scalarfield.shape[::-1],
+                                                             unitcell.flatten(), 0.3, normals='gradient')
+
+        # the mesh is centered, such that the normals point along the vertices
+        expected = vertices / np.linalg.norm(vertices, axis=1)[:,None]
+        self.assertGreater(np.min(np.sum(normals * expected, axis=1)), 0.99)
+
+        res = pytessel.marching_cubes(scalarfield, scalarfield.shape[::-1], unitcell.flatten(), 0.3,
+                                      normals='cached')
+        for a,b in zip((vertices, normals, indices), res):
+            np.testing.assert_array_equal(a, b)
+
+        with self.assertRaises(ValueError):
+            pytessel.marching_cubes(scalarfield, scalarfield.shape[::-1], unitcell.flatten(), 0.3,
+                                    normals='unknown')
+
+        # the central differences vanish for a field alternating along z
+        scalarfield = np.zeros((16, 16, 16), dtype=np.float32)
+        scalarfield[1::2] = 1.0
+        for method in ('gradient', 'interpolate'):
+            res = pytessel.marching_cubes(scalarfield, scalarfield.shape[::-1], np.diag([4.0, 4.0, 4.0]).flatten(),
+                                          0.5, normals=method)
+            self.assertGreater(len(res[1]), 0)
+            self.assertTrue(np.all(np.isfinite(res[1])))
+            np.testing.assert_allclose(np.linalg.norm(res[1], axis=1), 1.0, rtol=1e-5)
+
+    def testIsosurfaceStats(self):
+        """
+        Test the statistics of the construction of an isosurface
+        """
+        pytessel = PyTessel()
+
+        scalarfield, unitcell = gaussian_field([4,5,6])
+
+        active_cells = set()
+        for method in ('cubes', 'streaming', 'bricks', 'flying_edges'):
+            vertices, normals, indices, stats = pytessel.marching_cubes(scalarfield.flatten(), scalarfield.shape,
+                                                                        unitcell.flatten(), 0.1, method=method,
+                                                                        return_stats=True)
+            self.assertEqual(stats['triangles'], len(indices) // 3)
+            self.assertEqual(stats['unique_vertices'], len(vertices))
+            # only the returned arrays are retained after the construction
+            output = vertices.nbytes + normals.nbytes + indices.nbytes
+            self.assertEqual(stats['bytes_retained'], output)
+            self.assertGreaterEqual(stats['bytes_allocated'], output)
+            self.assertIn('vertex_lookups', stats)
+            self.assertIn('orient_triangles', stats['time'])
+            self.assertAlmostEqual(stats['time']['total'],
+                                   sum(t for phase, t in stats['time'].items() if phase != 'total'))
+            active_cells.add(stats['active_cells'])
+        self.assertEqual(len(active_cells), 1)
+
+        mesh = pytessel.marching_tetrahedra(scalarfield.flatten(), scalarfield.shape, unitcell.flatten(), 0.1,
+                                            return_stats=True)
+        self.assertEqual(mesh[3]['triangles'], len(mesh[2]) // 3)
+
+    def testIsosurfaceTrace(self):
+        """
+        Test writing a Chrome trace of the phases and parallel chunks
+        """
+        scalarfield, unitcell = gaussian_field([4,5,6])
+
+        with tempfile.TemporaryDirectory() as tmpdir:
+            filename = os.path.join(tmpdir, 'trace.json')
+            pytessel = PyTessel(num_threads=2, trace_file=filename)
+            mesh = pytessel.marching_cubes(scalarfield.flatten(), scalarfield.shape, unitcell.flatten(), 0.1)
+            self.assertGreater(len(mesh[2]), 0)
+
+            with open(filename) as f:
+                events = json.load(f)['traceEvents']
+
+        phases = {e['name'] for e in events if e['cat'] == 'phase'}
+        self.assertTrue({'vertices', 'classify', 'triangles', 'orient_triangles'} <= phases)
+        chunks = [e for e in events if e['cat'] == 'chunk']
+        self.assertGreater(len(chunks), 0)
+        for e in events:
+            self.assertEqual(e['ph'], 'X')
+            self.assertGreaterEqual(e['dur'], 0)
+        for e in chunks:
+            self.assertLess(e['args']['begin'], e['args']['end'])
+
+    def testIsosurfaceMulti(self):
+        """
+        Test that extracting several isovalues at once yields the same
+        isosurfaces as extracting them one by one
+        """
+        pytessel = PyTessel()
+
+        scalarfield, unitcell = gaussian_field([4,5,6])
+
+        isovalues = [0.05, 0.1, 0.5]
+        meshes = pytessel.marching_cubes_multi(scalarfield.flatten(), scalarfield.shape, unitcell.flatten(),
+                                               isovalues)
+        self.assertEqual(len(meshes), len(isovalues))
+
+        for isovalue, mesh in zip(isovalues, meshes):
+            ref = pytessel.marching_cubes(scalarfield.flatten(), scalarfield.shape, unitcell.flatten(), isovalue)
+            for a,b in zip(ref, mesh):
+                np.testing.assert_array_equal(a, b)
+
+    def testIsosurfaceBatch(self):
+        """
+        Test that extracting a batch of scalar fields yields the same
+        isosurfaces as extracting them one by one
+        """
+        pytessel = PyTessel(num_threads=3)
+
+        scalarfields = np.stack([gaussian_field(R, 12)[0] for R in ([4,5,6], [5,5,5], [6,4,5], [20,20,20])])
+        unitcells = np.stack([np.diag(np.ones(3) * l) for l in (10.0, 8.0, 12.0, 10.0)])
+        isovalues = [0.05, 0.1, 0.5, 0.1]
+
+        for method in ('cubes', 'bricks'):
+            vertices, normals, indices, voffsets, ioffsets = \
+                pytessel.marching_cubes_batch(scalarfields, unitcells, isovalues, method=method)
+            self.assertEqual(len(voffsets), len(scalarfields) + 1)
+            self.assertEqual(voffsets[-1], len(vertices))
+            self.assertEqual(ioffsets[-1], len(indices))
+
+            for i in range(len(scalarfields)):
+                ref = pytessel.marching_cubes(scalarfields[i].flatten(), scalarfields[i].shape,
+                                              unitcells[i].flatten(), isovalues[i], method=method)
+                np.testing.assert_array_equal(ref[0], vertices[voffsets[i]:voffsets[i+1]])
+                np.testing.assert_array_equal(ref[1], normals[voffsets[i]:voffsets[i+1]])
+                np.testing.assert_array_equal(ref[2], indices[ioffsets[i]:ioffsets[i+1]])
+
+        # the last field does not contain an isosurface
+        self.assertEqual(voffsets[-2], voffsets[-1])
+
+        # a list of fields with a shared unitcell and isovalue
+        mesh = pytessel.marching_cubes_batch(list(scalarfields[:2]), unitcells[0], 0.1)
+        ref = pytessel.marching_cubes(scalarfields[0].flatten(), scalarfields[0].shape,
+                                      unitcells[0].flatten(), 0.1)
+        np.testing.assert_array_equal(ref[0], mesh[0][:mesh[3][1]])
+
+        with self.assertRaises(ValueError):
+            pytessel.marching_cubes_batch(scalarfields, unitcells[:2], isovalues)
+
+    def testIsosurfaceSession(self):
+        """
+        Test that repeated extractions from a Tessellator yield the same
+        isosurfaces as marching_cubes
+        """
+        pytessel = PyTessel()
+
+        scalarfield, unitcell = gaussian_field([4,5,6], 40)
+        scalarfield = scalarfield.astype(np.float32)
+
+        for method in ('cubes', 'streaming', 'bricks', 'flying_edges'):
+            tessellator = Tessellator(scalarfield, unitcell, method=method, normals='cached')
+
+            # the arrays of the first extraction are kept alive, whereas
+            # those of the subsequent extractions are recycled
+            first = tessellator.extract(0.1)
+            for isovalue in (0.5, 0.05, 2.0, 0.1):
+                mesh = tessellator.extract(isovalue)
+                ref = pytessel.marching_cubes(scalarfield, scalarfield.shape, unitcell.flatten(), isovalue,
+                                              method=method, normals='cached')
+                for a,b in zip(ref, mesh):
+                    np.testing.assert_array_equal(a, b)
+                del mesh
+
+            ref = pytessel.marching_cubes(scalarfield, scalarfield.shape, unitcell.flatten(), 0.1,
+                                          method=method, normals='cached')
+            for a,b in zip(ref, first):
+                np.testing.assert_array_equal(a, b)
+
+            # once the buffers have been sized, the memory stays flat
+            for normals in ('interpolate', 'gradient'):
+                tessellator = Tessellator(scalarfield, unitcell, method=method, normals=normals)
+                nrbytes = []
+                for isovalue in (0.05, 0.5) * 3:
+                    *mesh, stats = tessellator.extract(isovalue, return_stats=True)
+                    nrbytes.append(stats['bytes_allocated'])
+                    del mesh
+                self.assertEqual(nrbytes[2:], nrbytes[:2] * 2)
+
+        with self.assertRaises(ValueError):
+            Tessellator(scalarfield, unitcell, method='unknown')
+
+    def testIsosurfaceTetrahedra(self):
+        """
+        Test Isosurface Generation of a Gaussian using marching tetrahedra
+        """
+        pytessel = PyTessel()
+
+        scalarfield, unitcell = gaussian_field([5,5,5])
+
+        vertices, normals, indices = pytessel.marching_tetrahedra(scalarfield.flatten(), scalarfield.shape,
+                                                                  unitcell.flatten(), 0.1)
+
+        self.assertEqual(len(vertices), 422)
+        self.assertEqual(len(normals),  422)
+        self.assertEqual(len(indices),  2520)
+
+        # every edge of the closed surface is shared by exactly two triangles
+        edges = np.sort(indices.reshape(-1,3)[:,[0,1,1,2,2,0]].reshape(-1,2), axis=1)
+        _, counts = np.unique(edges, axis=0, return_counts=True)
+        self.assertTrue(np.all(counts == 2))
+
 def gaussian(r, R):
     return np.exp(-(r-R).dot((r-R)))
 
+def gaussian_field(R, n=20):
+    """
+    Gaussian centered at R sampled on a grid of n x n x n points spanning a
+    cubic unitcell with edges of 10; the grid is organized with z the
+    slowest moving index and x the fastest moving index
+    """
+    x = np.linspace(0, 10, n)
+    grid = np.flipud(np.vstack(np.meshgrid(x, x, x, indexing='ij')).reshape(3,-1)).T
+
+    scalarfield = np.reshape(np.array([gaussian(r,R) for r in grid]), (n,n,n), order='F')
+    unitcell = np.diag(np.ones(3) * 10.0)
+
+    return scalarfield, unitcell
+
 if __name__ == '__main__':
     unittest.main()